@@ -0,0 +1,296 @@
+//
+//  Copyright (c) 2023, Rice University
+//  All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//  
+//  1. Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//  
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//  
+//  3. Neither the name of the copyright holder nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------
+//
+//  Multi-build driver (--builds).
+//
+// ----------------------------------------------------------------------
+
+#include "unknown-x86-internal.h"
+
+//----------------------------------------------------------------------
+
+// Multi-build driver:  --builds name=worker,name=worker,...  filename
+//
+// Each worker is this program built against a different dyninst
+// install (see mk-test.sh).  The driver reads the file into the page
+// cache once, then runs the workers one at a time (so they don't
+// compete for cpus) with the same options, a shared XED verdict
+// cache and --kv-out, and prints one table of the results.  Each
+// worker's output goes to unknown-x86-<name>.log.
+//
+class BuildInfo {
+public:
+    string  name;
+    string  worker;
+    string  log;
+    map <string, string> result;
+    double  wall_secs;
+    long  maxrss_kb;
+    int   status;
+};
+
+// Map the file with MAP_POPULATE to read it all into the page cache.
+void *
+prefetchFile(const char * filename, size_t & size)
+{
+    int fd = open(filename, O_RDONLY);
+    struct stat sb;
+
+    size = 0;
+    if (fd < 0 || fstat(fd, &sb) != 0) {
+	err(1, "unable to open: %s", filename);
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+    void * addr = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+	return NULL;
+    }
+    size = sb.st_size;
+    return addr;
+}
+
+// Run one worker and wait for it.
+static void
+runWorker(BuildInfo & build, vector <string> & args)
+{
+    vector <char *> argv;
+
+    argv.push_back((char *) build.worker.c_str());
+    for (auto it = args.begin(); it != args.end(); ++it) {
+	argv.push_back((char *) it->c_str());
+    }
+    argv.push_back(NULL);
+
+    double start = omp_get_wtime();
+    pid_t pid = fork();
+
+    if (pid < 0) {
+	err(1, "fork failed");
+    }
+    if (pid == 0) {
+	int fd = open(build.log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd >= 0) {
+	    dup2(fd, 1);
+	    dup2(fd, 2);
+	    close(fd);
+	}
+	execv(argv[0], argv.data());
+	err(127, "exec failed: %s", argv[0]);
+    }
+
+    struct rusage usage;
+    int status = 0;
+
+    while (wait4(pid, &status, 0, &usage) < 0) {
+	if (errno != EINTR) {
+	    err(1, "wait4 failed");
+	}
+    }
+
+    build.wall_secs = omp_get_wtime() - start;
+    build.maxrss_kb = usage.ru_maxrss;
+    build.status = status;
+}
+
+int
+runBuilds(char **argv)
+{
+    vector <BuildInfo> builds;
+    string spec(opts.builds);
+    size_t pos = 0;
+
+    while (pos < spec.size()) {
+	size_t end = spec.find(',', pos);
+	if (end == string::npos) {
+	    end = spec.size();
+	}
+	string item = spec.substr(pos, end - pos);
+	size_t eq = item.find('=');
+	BuildInfo build;
+
+	build.worker = (eq == string::npos) ? item : item.substr(eq + 1);
+	build.name = (eq == string::npos) ? to_string(builds.size() + 1) : item.substr(0, eq);
+	build.log = "unknown-x86-" + build.name + ".log";
+	if (access(build.worker.c_str(), X_OK) != 0) {
+	    errx(1, "worker is not executable: %s", build.worker.c_str());
+	}
+	builds.push_back(build);
+	pos = end + 1;
+    }
+    if (builds.empty()) {
+	usage("empty arg for --builds");
+    }
+
+    // shared xed cache, use a temp file if not given
+    string cache;
+    bool tmp_cache = false;
+
+    if (opts.xed_cache != NULL) {
+	cache = opts.xed_cache;
+    }
+    else {
+	char path[] = "/tmp/unknown-x86-cache-XXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) {
+	    err(1, "mkstemp failed");
+	}
+	close(fd);
+	unlink(path);
+	cache = path;
+	tmp_cache = true;
+    }
+
+    char kv_path[] = "/tmp/unknown-x86-kv-XXXXXX";
+    int kv_fd = mkstemp(kv_path);
+    if (kv_fd < 0) {
+	err(1, "mkstemp failed");
+    }
+    close(kv_fd);
+
+    // forward the options, except the ones for the driver
+    vector <string> args;
+
+    for (int n = 1; n < opts.file_index; n++) {
+	string arg(argv[n]);
+
+	if (arg == "-builds" || arg == "--builds" || arg == "-xed-cache"
+	    || arg == "--xed-cache" || arg == "-kv-out" || arg == "--kv-out") {
+	    n++;
+	    continue;
+	}
+	args.push_back(arg);
+    }
+    args.push_back("--xed-cache");
+    args.push_back(cache);
+    args.push_back("--kv-out");
+    args.push_back(kv_path);
+    args.push_back(opts.filename);
+
+    size_t file_size;
+    void * file_addr = prefetchFile(opts.filename, file_size);
+
+    for (auto it = builds.begin(); it != builds.end(); ++it) {
+	cout << "\nrunning build: " << it->name << "  (" << it->worker << ") ..." << endl;
+
+	unlink(kv_path);
+	runWorker(*it, args);
+	readKeyValues(kv_path, it->result);
+
+	if (! WIFEXITED(it->status) || WEXITSTATUS(it->status) != 0) {
+	    cout << "build " << it->name << " failed, see: " << it->log << endl;
+	}
+    }
+
+    if (file_addr != NULL) {
+	munmap(file_addr, file_size);
+    }
+    unlink(kv_path);
+    if (tmp_cache) {
+	unlink(cache.c_str());
+    }
+
+    // ------------------------------------------------------------
+    // Side by side table, one column per build
+    // ------------------------------------------------------------
+    printf("\nSummary:\n\nfile: %s\n\n", opts.filename);
+
+    printf("%-16s", "build:");
+    for (auto it = builds.begin(); it != builds.end(); ++it) {
+	printf("  %14s", it->name.c_str());
+    }
+    printf("\n");
+
+    const char * rows[][2] = {
+	{ "parse sec:",  "parse_secs" },
+	{ "check sec:",  "check_secs" },
+	{ "gaps sec:",   "gaps_secs" },
+	{ "peak rss MB:", NULL },
+	{ "funcs:",      "funcs" },
+	{ "blocks:",     "blocks" },
+	{ "instns:",     "instns" },
+	{ "coverage %:", NULL },
+	{ "unknown:",    "unknown" },
+	{ "bad length:", "bad_length" },
+	{ "gaps:",       "gaps" },
+	{ "gap bytes:",  "gap_bytes" },
+	{ "overlap:",    "overlap" },
+	{ "exit:",       NULL },
+    };
+
+    for (long r = 0; r < (long) (sizeof(rows) / sizeof(rows[0])); r++) {
+	printf("%-16s", rows[r][0]);
+
+	for (auto it = builds.begin(); it != builds.end(); ++it) {
+	    map <string, string> & kv = it->result;
+	    string val = "-";
+	    char str[100];
+
+	    if (rows[r][1] != NULL) {
+		if (kv.find(rows[r][1]) != kv.end()) {
+		    val = kv[rows[r][1]];
+		}
+	    }
+	    else if (strcmp(rows[r][0], "peak rss MB:") == 0) {
+		snprintf(str, sizeof(str), "%.1f", it->maxrss_kb / 1024.0);
+		val = str;
+	    }
+	    else if (strcmp(rows[r][0], "coverage %:") == 0) {
+		double code = atof(kv["code_bytes"].c_str());
+		if (code > 0.0) {
+		    snprintf(str, sizeof(str), "%.2f", 100.0 * atof(kv["covered_bytes"].c_str()) / code);
+		    val = str;
+		}
+	    }
+	    else {
+		if (WIFEXITED(it->status)) {
+		    snprintf(str, sizeof(str), "%d", WEXITSTATUS(it->status));
+		}
+		else {
+		    snprintf(str, sizeof(str), "sig %d", WTERMSIG(it->status));
+		}
+		val = str;
+	    }
+	    printf("  %14s", val.c_str());
+	}
+	printf("\n");
+    }
+
+    printf("\nlogs:");
+    for (auto it = builds.begin(); it != builds.end(); ++it) {
+	printf("  %s", it->log.c_str());
+    }
+    printf("\n\n");
+
+    return 0;
+}
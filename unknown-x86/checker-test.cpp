@@ -0,0 +1,181 @@
+//
+//  Copyright (c) 2023, Rice University
+//  All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//  
+//  1. Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//  
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//  
+//  3. Neither the name of the copyright holder nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------
+//
+//  Smoke test for the checker library (see unknown-x86.h).  Check one
+//  binary twice on one thread, then from two threads at once (one with
+//  the default options, one with its own), each time on a new
+//  CodeObject, and compare the counts and findings with the first
+//  check.  Exits 0 if they all agree.
+//
+//  Build and run with:  ./mk-test.sh --test  [ binary ]
+//
+// ----------------------------------------------------------------------
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <thread>
+
+#include "CodeObject.h"
+#include "CodeSource.h"
+#include "Symtab.h"
+
+#include "unknown-x86.h"
+
+using namespace Dyninst;
+using namespace ParseAPI;
+using namespace SymtabAPI;
+using namespace std;
+
+static Symtab * the_symtab = NULL;
+
+//----------------------------------------------------------------------
+
+// Check the binary on a new CodeObject, with the default options, or
+// with options for this call if not NULL.
+static long
+runCheck(const CheckerOptions * options, CheckerResult & result)
+{
+    CodeObject * code_obj = new CodeObject(new SymtabCodeSource(the_symtab));
+    long ret;
+
+    if (options == NULL) {
+	ret = checkCodeObject(code_obj, CheckerRanges(), result);
+    }
+    else {
+	ret = checkCodeObject(code_obj, CheckerRanges(), *options, result);
+    }
+
+    delete code_obj;
+    return ret;
+}
+
+// Compare result with the first check and print any difference.
+// Returns 1 if they differ, else 0.
+static int
+compareResult(const char * name, long ret, const CheckerResult & result,
+	      long ret0, const CheckerResult & result0)
+{
+    string diff;
+
+    if (ret != ret0) { diff += " problems"; }
+    if (result.funcs != result0.funcs) { diff += " funcs"; }
+    if (result.blocks != result0.blocks) { diff += " blocks"; }
+    if (result.instns != result0.instns) { diff += " instns"; }
+    if (result.bytes != result0.bytes) { diff += " bytes"; }
+    if (result.unknown != result0.unknown) { diff += " unknown"; }
+    if (result.bad_length != result0.bad_length) { diff += " bad_length"; }
+    if (result.block_errors != result0.block_errors) { diff += " block_errors"; }
+    if (result.gaps != result0.gaps) { diff += " gaps"; }
+    if (result.gap_bytes != result0.gap_bytes) { diff += " gap_bytes"; }
+    if (result.overlap != result0.overlap) { diff += " overlap"; }
+    if (result.error != result0.error) { diff += " error"; }
+
+    if (result.findings.size() != result0.findings.size()) {
+	diff += " findings";
+    }
+    else {
+	for (size_t n = 0; n < result.findings.size(); n++) {
+	    const CheckerFinding & a = result.findings[n];
+	    const CheckerFinding & b = result0.findings[n];
+
+	    if (a.addr != b.addr || a.func != b.func || a.kind != b.kind
+		|| a.size != b.size || a.funcs != b.funcs) {
+		diff += " findings";
+		break;
+	    }
+	}
+    }
+
+    printf("%-12s  problems: %ld  funcs: %ld  instns: %ld  unknown: %ld  findings: %ld  %s\n",
+	   name, ret, result.funcs, result.instns, result.unknown,
+	   (long) result.findings.size(), diff.empty() ? "ok" : "DIFFERS");
+
+    if (! diff.empty()) {
+	printf("%-12s  differs in:%s\n", "", diff.c_str());
+	return 1;
+    }
+    if (ret < 0) {
+	printf("%-12s  error: %s\n", "", result.error.c_str());
+    }
+    return 0;
+}
+
+//----------------------------------------------------------------------
+
+int
+main(int argc, char **argv)
+{
+    const char * filename = (argc > 1) ? argv[1] : argv[0];
+
+    if (! Symtab::openFile(the_symtab, filename)) {
+	errx(1, "Symtab::openFile (on disk) failed: %s", filename);
+    }
+
+    CheckerOptions options;
+    options.jobs = 2;
+    options.check_jobs = 2;
+    checkerInit(options);
+
+    // other options for the second thread, the results are the same
+    CheckerOptions thread_options;
+    thread_options.jobs = 1;
+    thread_options.check_jobs = 3;
+
+    printf("file: %s\n\n", filename);
+
+    // twice on one thread
+    CheckerResult result0, result1;
+    long ret0 = runCheck(NULL, result0);
+    long ret1 = runCheck(NULL, result1);
+
+    // and from two threads at once
+    CheckerResult result2, result3;
+    long ret2 = 0, ret3 = 0;
+
+    std::thread thr2([&] { ret2 = runCheck(NULL, result2); });
+    std::thread thr3([&] { ret3 = runCheck(&thread_options, result3); });
+    thr2.join();
+    thr3.join();
+
+    int errors = 0;
+
+    errors += compareResult("first", ret0, result0, ret0, result0);
+    errors += compareResult("second", ret1, result1, ret0, result0);
+    errors += compareResult("thread 1", ret2, result2, ret0, result0);
+    errors += compareResult("thread 2", ret3, result3, ret0, result0);
+
+    printf("\n%s\n", (errors == 0) ? "ok" : "FAILED");
+
+    return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,2139 @@
+//
+//  Copyright (c) 2023, Rice University
+//  All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//  
+//  1. Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//  
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//  
+//  3. Neither the name of the copyright holder nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------
+//
+//  The checker core:  the unknown instruction callback and the three
+//  phases (parse, check the blocks of each function, gaps) for one
+//  analysis (ctx).  The program and the checker library
+//  (libunknown-x86.so, see unknown-x86.h) both use this file.
+//
+// ----------------------------------------------------------------------
+
+#include "unknown-x86-internal.h"
+
+static mutex print_mutex;
+
+thread_local Analysis * ctx = NULL;
+
+// Analyses in progress, for the unknown callback.
+static mutex analysis_mutex;
+static vector <Analysis *> live_analyses;
+
+Options opts;
+
+// Defined after opts, the per analysis options start as the
+// program's options.
+Analysis::Analysis(const char * name)
+    : num_fix_branch(0), num_xed_errors(0), num_problems(0), fail_fast_stop(false),
+      failed(false)
+{
+    static atomic <long> next_id(1);
+
+    filename = name;
+    id = next_id++;
+    jobs = opts.jobs;
+    check_jobs = opts.check_jobs;
+    fix_valid = opts.fix_valid;
+    fix_troll = opts.fix_troll;
+    for (int k = 0; k < NUM_KINDS; k++) {
+	kind_count[k] = 0;
+    }
+    offsets = NULL;
+    kv_out = NULL;
+    mem_image = NULL;
+    mem_image_size = 0;
+    symtab = NULL;
+    initial_parse = 0;
+    num_unknown = 0;
+    num_unknown_valid = 0;
+    num_unknown_troll = 0;
+    num_unknown_error = 0;
+    num_gaps = 0;
+    num_gaps_16 = 0;
+    num_gaps_64 = 0;
+    num_gaps_256 = 0;
+    num_gaps_other = 0;
+    num_overlap = 0;
+    size_gaps = 0;
+    size_gaps_16 = 0;
+    size_gaps_64 = 0;
+    size_gaps_256 = 0;
+    size_gaps_other = 0;
+    parse_secs = 0.0;
+    check_secs = 0.0;
+    gaps_secs = 0.0;
+    num_clone_groups = 0;
+    num_clones = 0;
+    clone_bytes = 0;
+    clone_secs = 0.0;
+    parse_cpu = 0.0;
+    check_cpu = 0.0;
+    gaps_cpu = 0.0;
+    max_threads = 0;
+    code_bytes = 0;
+    covered_bytes = 0;
+    want_findings = false;
+    want_bounds = false;
+    profile_total = 0;
+    profile_mapped = 0;
+    objdump_num_insns = 0;
+    objdump_matched = 0;
+    objdump_agree = 0;
+    objdump_dyn_wrong = 0;
+    objdump_xed_wrong = 0;
+    objdump_differs = 0;
+    objdump_all_differ = 0;
+    objdump_missing = 0;
+    objdump_bytes = 0;
+    objdump_secs = 0.0;
+    bound_num_lines = 0;
+    bound_lines_checked = 0;
+    bound_lines_bad = 0;
+    bound_num_relocs = 0;
+    bound_relocs_checked = 0;
+    bound_relocs_bad = 0;
+    num_fde_seeded = 0;
+    fde_bytes = 0;
+    fde_covered = 0;
+    num_fde_missed = 0;
+    eh_secs = 0.0;
+}
+
+//----------------------------------------------------------------------
+
+// True if addr is inside one of the ranges.
+bool
+inRanges(const RangeList & ranges, Address addr)
+{
+    auto it = std::upper_bound(ranges.begin(), ranges.end(),
+			       make_pair(addr, (Address) ULONG_MAX));
+    if (it == ranges.begin()) {
+	return false;
+    }
+    --it;
+    return addr >= it->first && addr < it->second;
+}
+
+//----------------------------------------------------------------------
+
+// Sort Functions by entry address, low to high.
+bool
+FuncLessThan(ParseAPI::Function * f1, ParseAPI::Function * f2)
+{
+    return f1->addr() < f2->addr();
+}
+
+// Sort Blocks by start address, low to high.
+bool
+BlockLessThan(Block * b1, Block * b2)
+{
+    return b1->start() < b2->start();
+}
+
+// Sort Findings by address, low to high.
+bool
+FindingLessThan(const Finding & f1, const Finding & f2)
+{
+    return f1.addr < f2.addr;
+}
+
+// Sort and merge overlapping or adjacent ranges.
+void
+mergeRanges(RangeList & ranges)
+{
+    RangeList merged;
+
+    std::sort(ranges.begin(), ranges.end());
+
+    for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+	if (! merged.empty() && it->first <= merged.back().second) {
+	    merged.back().second = std::max(merged.back().second, it->second);
+	}
+	else {
+	    merged.push_back(*it);
+	}
+    }
+    ranges.swap(merged);
+}
+
+//----------------------------------------------------------------------
+
+// Kinds of output records (KIND_* in unknown-x86.h)
+const char * kind_name[NUM_KINDS] = {
+    "unknown", "bad", "block", "gap", "overlap"
+};
+
+//----------------------------------------------------------------------
+
+// NUMA topology and thread placement.
+//
+// We read the node to cpu map from sysfs and pin threads with
+// sched_setaffinity(), so there is no dependence on libnuma.  Each
+// thread is pinned to all the cpus of one node, not to a single cpu.
+//
+// OpenMP reuses the same pool of threads for each parallel region,
+// so pinning the threads in an empty region before parse() also
+// pins dyninst's parse threads.  Dyninst allocates the CFG from the
+// thread that parses it, so first-touch puts each function's blocks
+// on the node of the thread that built them.  After the parse and
+// after phase 2, the threads get their original affinity back.
+//
+vector <NumaNode> numa_nodes;
+
+// Parse a sysfs style cpu or node list, eg: "0-15,32-47".
+static void
+parseCpuList(const char * str, vector <int> & list)
+{
+    const char * p = str;
+
+    while (*p != 0) {
+	char * end;
+	long lo = strtol(p, &end, 10);
+	if (end == p) {
+	    break;
+	}
+	long hi = lo;
+	p = end;
+	if (*p == '-') {
+	    hi = strtol(p + 1, &end, 10);
+	    p = end;
+	}
+	for (long n = lo; n <= hi; n++) {
+	    list.push_back(n);
+	}
+	if (*p != ',') {
+	    break;
+	}
+	p++;
+    }
+}
+
+// Fill in numa_nodes from /sys/devices/system/node, restricted to the
+// cpus in our affinity mask (taskset, cgroups) and to --numa-nodes.
+// If there is no sysfs numa info, then use one node with all cpus.
+void
+getNumaTopology()
+{
+    cpu_set_t allowed;
+    vector <int> want;
+
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+	err(1, "sched_getaffinity failed");
+    }
+    if (opts.numa_nodes != NULL) {
+	parseCpuList(opts.numa_nodes, want);
+    }
+
+    numa_nodes.clear();
+
+    DIR * dir = opendir("/sys/devices/system/node");
+    struct dirent * ent;
+
+    while (dir != NULL && (ent = readdir(dir)) != NULL) {
+	int node;
+	char path[300];
+	char line[4096];
+
+	if (sscanf(ent->d_name, "node%d", &node) != 1) {
+	    continue;
+	}
+	if (! want.empty() && std::find(want.begin(), want.end(), node) == want.end()) {
+	    continue;
+	}
+	snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", ent->d_name);
+	FILE * fp = fopen(path, "r");
+	if (fp == NULL) {
+	    continue;
+	}
+	if (fgets(line, sizeof(line), fp) != NULL) {
+	    NumaNode nn;
+	    vector <int> cpus;
+
+	    nn.node = node;
+	    parseCpuList(line, cpus);
+	    for (auto it = cpus.begin(); it != cpus.end(); ++it) {
+		if (*it < CPU_SETSIZE && CPU_ISSET(*it, &allowed)) {
+		    nn.cpus.push_back(*it);
+		}
+	    }
+	    if (! nn.cpus.empty()) {
+		numa_nodes.push_back(nn);
+	    }
+	}
+	fclose(fp);
+    }
+    if (dir != NULL) {
+	closedir(dir);
+    }
+
+    if (numa_nodes.empty()) {
+	if (! want.empty()) {
+	    errx(1, "no usable cpus on numa nodes: %s", opts.numa_nodes);
+	}
+	NumaNode nn;
+	nn.node = 0;
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+	    if (CPU_ISSET(cpu, &allowed)) {
+		nn.cpus.push_back(cpu);
+	    }
+	}
+	numa_nodes.push_back(nn);
+    }
+
+    std::sort(numa_nodes.begin(), numa_nodes.end(),
+	      [](const NumaNode & a, const NumaNode & b) { return a.node < b.node; });
+}
+
+// Return the index into numa_nodes for thread number tid.  Spread
+// alternates nodes, compact fills each node's cpus in order.
+int
+numaThreadNode(int tid)
+{
+    int num_nodes = numa_nodes.size();
+
+    if (opts.numa == NUMA_SPREAD || num_nodes == 1) {
+	return tid % num_nodes;
+    }
+
+    long total = 0;
+    for (int k = 0; k < num_nodes; k++) {
+	total += numa_nodes[k].cpus.size();
+    }
+    long pos = tid % total;
+    for (int k = 0; k < num_nodes; k++) {
+	if (pos < (long) numa_nodes[k].cpus.size()) {
+	    return k;
+	}
+	pos -= numa_nodes[k].cpus.size();
+    }
+    return 0;
+}
+
+// The thread's affinity mask before its first pinThread(), so that
+// unpinThread() can put it back.
+static thread_local cpu_set_t saved_affinity;
+static thread_local bool saved_affinity_valid = false;
+
+// Pin the calling thread to all cpus on numa_nodes[index].
+void
+pinThread(int index)
+{
+    cpu_set_t set;
+
+    if (! saved_affinity_valid
+	&& sched_getaffinity(0, sizeof(saved_affinity), &saved_affinity) == 0) {
+	saved_affinity_valid = true;
+    }
+
+    CPU_ZERO(&set);
+    for (auto it = numa_nodes[index].cpus.begin(); it != numa_nodes[index].cpus.end(); ++it) {
+	CPU_SET(*it, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+	warn("sched_setaffinity failed for numa node %d", numa_nodes[index].node);
+    }
+}
+
+// Restore the calling thread's affinity from before pinThread().
+void
+unpinThread()
+{
+    if (saved_affinity_valid) {
+	if (sched_setaffinity(0, sizeof(saved_affinity), &saved_affinity) != 0) {
+	    warn("sched_setaffinity failed restoring thread affinity");
+	}
+	saved_affinity_valid = false;
+    }
+}
+
+// Return the numa_nodes index of the page holding each address, or
+// -1 if unknown.  move_pages() with a NULL node list only queries.
+static void
+getPageNodes(const vector <void *> & addrs, vector <int> & index)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    vector <void *> pages(addrs.size());
+    vector <int> status(addrs.size(), -1);
+
+    for (long n = 0; n < (long) addrs.size(); n++) {
+	pages[n] = (void *) ((uintptr_t) addrs[n] & ~ (uintptr_t) (page_size - 1));
+    }
+
+    index.assign(addrs.size(), -1);
+    if (addrs.empty()
+	|| syscall(SYS_move_pages, 0, pages.size(), pages.data(), NULL, status.data(), 0) != 0) {
+	return;
+    }
+
+    for (long n = 0; n < (long) addrs.size(); n++) {
+	for (int k = 0; k < (int) numa_nodes.size(); k++) {
+	    if (numa_nodes[k].node == status[n]) {
+		index[n] = k;
+		break;
+	    }
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+
+// Thread budget and CPU usage per phase.
+//
+// Dyninst parses with OpenMP but also uses TBB, and TBB starts its
+// own pool of workers, one per core, the first time anything runs in
+// it.  So, OpenMP is the one pool for our phases, and TBB is capped
+// at the same number of threads with global_control (process-wide,
+// so only in the program, not the library) and the parse runs inside
+// a task arena of -j slots.  The summary
+// reports the CPU time and utilization of each phase (from
+// getrusage) and the most threads seen in the process.
+//
+
+// User plus system CPU secs for the whole process.
+double
+cpuSecs()
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+	+ (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+// Number of threads in the process, from /proc/self/status.
+long
+numThreads()
+{
+    FILE * fp = fopen("/proc/self/status", "r");
+    char line[256];
+    long num = 0;
+
+    if (fp == NULL) {
+	return 0;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if (sscanf(line, "Threads: %ld", &num) == 1) {
+	    break;
+	}
+    }
+    fclose(fp);
+    return num;
+}
+
+// Percent of threads x wall time that was busy.
+double
+utilization(double cpu, double wall, int threads)
+{
+    return (wall > 0.0 && threads > 0) ? 100.0 * cpu / (wall * threads) : 0.0;
+}
+
+//----------------------------------------------------------------------
+
+// Output records and volume control.
+//
+// Every unknown, bad length, block error, gap and overlap line is a
+// record of some kind.  The first max_print records of each kind are
+// printed, the next ones go into a uniform reservoir sample of size
+// opts.sample, and the rest are only counted.  The counts and
+// reservoirs belong to the analysis (ctx), the reservoirs are per
+// thread (no locking) and are merged at the end of each phase.
+//
+static thread_local RecordSampler * my_sampler = NULL;
+static thread_local long my_sampler_id = 0;
+
+// Append printf-style output to a string buffer.
+void
+bufPrintf(string & buf, const char * fmt, ...)
+{
+    char str[500];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(str, sizeof(str), fmt, ap);
+    va_end(ap);
+
+    buf += str;
+}
+
+// Print, sample or count one record.  If out is non-null, then
+// append printed records to out, else print them now.
+void
+emitRecord(int kind, const string & line, string * out)
+{
+    long n = ctx->kind_count[kind]++;
+    long limit = opts.max_print[kind];
+
+    if (limit < 0 || n < limit) {
+	if (out != NULL) {
+	    *out += line;
+	}
+	else {
+	    print_mutex.lock();
+	    fputs(line.c_str(), stdout);
+	    fflush(stdout);
+	    print_mutex.unlock();
+	}
+	return;
+    }
+
+    if (opts.sample <= 0) {
+	return;
+    }
+
+    if (my_sampler == NULL || my_sampler_id != ctx->id) {
+	ctx->sampler_lock.lock();
+	my_sampler = new RecordSampler(12345 + ctx->samplers.size());
+	my_sampler_id = ctx->id;
+	ctx->samplers.push_back(my_sampler);
+	ctx->sampler_lock.unlock();
+    }
+
+    // standard reservoir sample (algorithm R) within this thread
+    long seen = my_sampler->seen[kind]++;
+    vector <string> & res = my_sampler->sample[kind];
+
+    if ((long) res.size() < opts.sample) {
+	res.push_back(line);
+    }
+    else {
+	long j = my_sampler->rng() % (seen + 1);
+	if (j < opts.sample) {
+	    res[j] = line;
+	}
+    }
+}
+
+// Merge the per-thread reservoirs for one kind and print the sample.
+// Pick thread t with probability (remaining seen in t) / (remaining
+// total) and take a random item from its reservoir.  This gives a
+// uniform sample (without replacement) of all the sampled records.
+//
+void
+printSamples(int kind)
+{
+    vector <RecordSampler *> & samplers = ctx->samplers;
+    long total = 0;
+    vector <long> left(samplers.size());
+
+    for (long t = 0; t < (long) samplers.size(); t++) {
+	left[t] = samplers[t]->seen[kind];
+	total += left[t];
+    }
+    if (total == 0) {
+	return;
+    }
+
+    mt19937_64 rng(54321 + kind);
+    long num = std::min(total, opts.sample);
+    long suppressed = ctx->kind_count[kind] - opts.max_print[kind];
+
+    printf("\nsample of %ld out of %ld more %s records:\n",
+	   num, suppressed, kind_name[kind]);
+
+    for (long n = 0; n < num; n++) {
+	long r = rng() % total;
+	long t = 0;
+
+	while (r >= left[t]) {
+	    r -= left[t];
+	    t++;
+	}
+
+	vector <string> & res = samplers[t]->sample[kind];
+	long j = rng() % res.size();
+
+	fputs(res[j].c_str(), stdout);
+	res[j] = res.back();
+	res.pop_back();
+	left[t]--;
+	total--;
+    }
+}
+
+// Print the per-kind output counts, if any kind was limited.
+void
+printRecordCounts()
+{
+    bool limited = false;
+
+    for (int k = 0; k < NUM_KINDS; k++) {
+	if (opts.max_print[k] >= 0 && ctx->kind_count[k] > opts.max_print[k]) {
+	    limited = true;
+	}
+    }
+    if (! limited) {
+	return;
+    }
+
+    printf("\noutput records:\n");
+
+    for (int k = 0; k < NUM_KINDS; k++) {
+	long total = ctx->kind_count[k];
+	long printed = (opts.max_print[k] >= 0) ? std::min(total, opts.max_print[k]) : total;
+	long sampled = std::min(total - printed, opts.sample);
+
+	printf("%-8s  total: %10ld  printed: %8ld  sampled: %6ld  suppressed: %10ld\n",
+	       kind_name[k], total, printed, sampled, total - printed - sampled);
+    }
+}
+
+// Count one confirmed problem, and stop phase 2 after opts.fail_fast
+// of them.
+static void
+noteProblem()
+{
+    long num = ++ctx->num_problems;
+
+    if (opts.fail_fast > 0 && num >= opts.fail_fast) {
+	ctx->fail_fast_stop = true;
+    }
+}
+
+// Record an error that ends the current analysis (the first message
+// wins) and stop phase 2.  The library returns it in CheckerResult,
+// the program prints it and fails the file, so nothing under the
+// callback or the checks exits the process.
+static void
+analysisError(const char * fmt, ...)
+{
+    char str[500];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(str, sizeof(str), fmt, ap);
+    va_end(ap);
+
+    ctx->lock.lock();
+    if (! ctx->failed) {
+	ctx->error = str;
+	ctx->failed = true;
+    }
+    ctx->lock.unlock();
+
+    ctx->fail_fast_stop = true;
+}
+
+//----------------------------------------------------------------------
+
+// Verify invalid Dyninst buffers for valid XED instructions.
+// Three possibilities:
+//
+//  1. XED says valid instruction at beginning of buffer.
+//    This is an instruction that dyninst doesn't know about.
+//
+//  2. XED says invalid, but skip ahead a few bytes (troll) and XED
+//    says valid.  Likely dyninst has the length wrong on the previous
+//    instruction.
+//
+//  3. XED says error and trolling doesn't find anything.
+//
+// If Dyninst doesn't recognize an op code, it should show up as (1).
+// If it thinks it does but gets it wrong, it will show up as (2) or (3).
+//
+#define MY_BUF_SIZE (XED_MAX_INSTRUCTION_BYTES + 4)
+
+//----------------------------------------------------------------------
+
+// With --fix, build the replacement instruction from the XED decode
+// instead of a plain no-op, so that if the unknown instruction is a
+// branch, call or return, dyninst follows the right control flow the
+// first time.  Dyninst computes the category from the entry ID, and
+// parsing uses the successors, so we set both, the same way as the
+// dyninst x86 decoder: relative targets are rip + size + disp, and
+// conditional branches also get a fall-through successor.
+//
+// Indirect jumps and calls are not translated (we would need the
+// full operand), they stay as fake no-ops.
+//
+class XedBranchMap {
+public:
+    xed_iclass_enum_t  iclass;
+    entryID  id;
+    const char *  name;
+};
+
+static const XedBranchMap xed_branch_map[] = {
+    { XED_ICLASS_JB,     e_jb,     "jb" },
+    { XED_ICLASS_JBE,    e_jbe,    "jbe" },
+    { XED_ICLASS_JL,     e_jl,     "jl" },
+    { XED_ICLASS_JLE,    e_jle,    "jle" },
+    { XED_ICLASS_JNB,    e_jnb,    "jnb" },
+    { XED_ICLASS_JNBE,   e_jnbe,   "jnbe" },
+    { XED_ICLASS_JNL,    e_jnl,    "jnl" },
+    { XED_ICLASS_JNLE,   e_jnle,   "jnle" },
+    { XED_ICLASS_JNO,    e_jno,    "jno" },
+    { XED_ICLASS_JNP,    e_jnp,    "jnp" },
+    { XED_ICLASS_JNS,    e_jns,    "jns" },
+    { XED_ICLASS_JNZ,    e_jnz,    "jnz" },
+    { XED_ICLASS_JO,     e_jo,     "jo" },
+    { XED_ICLASS_JP,     e_jp,     "jp" },
+    { XED_ICLASS_JS,     e_js,     "js" },
+    { XED_ICLASS_JZ,     e_jz,     "jz" },
+    { XED_ICLASS_JRCXZ,  e_jcxz_jec, "jrcxz" },
+    { XED_ICLASS_JECXZ,  e_jcxz_jec, "jecxz" },
+    { XED_ICLASS_JCXZ,   e_jcxz_jec, "jcxz" },
+    { XED_ICLASS_LOOP,   e_loop,   "loop" },
+    { XED_ICLASS_LOOPE,  e_loope,  "loope" },
+    { XED_ICLASS_LOOPNE, e_loopn,  "loopne" },
+};
+
+static Instruction
+makeFakeNop(unsigned int len, const unsigned char * ptr)
+{
+    return Instruction {
+	{ e_nop, "nop", Arch_x86_64 },
+	len,
+	ptr,
+	Arch_x86_64
+    };
+}
+
+// rip + len + disp, where rip is the start of the instruction.
+static Expression::Ptr
+makeRelTarget(unsigned int len, long disp)
+{
+    Expression::Ptr rip(new RegisterAST(x86_64::rip));
+    Expression::Ptr size(Immediate::makeImmediate(Result(s64, len)));
+    Expression::Ptr offset(Immediate::makeImmediate(Result(s64, disp)));
+    BinaryFunction::funcT::Ptr add1(new BinaryFunction::addResult());
+    BinaryFunction::funcT::Ptr add2(new BinaryFunction::addResult());
+    Expression::Ptr post_rip(new BinaryFunction(rip, size, u64, add1));
+
+    return Expression::Ptr(new BinaryFunction(offset, post_rip, u64, add2));
+}
+
+static Instruction
+makeXedInstruction(xed_decoded_inst_t * xedd, unsigned int len,
+		   const unsigned char * ptr)
+{
+    xed_category_enum_t category = xed_decoded_inst_get_category(xedd);
+    xed_iclass_enum_t iclass = xed_decoded_inst_get_iclass(xedd);
+    bool has_disp = xed_decoded_inst_get_branch_displacement_width(xedd) > 0;
+    long disp = xed_decoded_inst_get_branch_displacement(xedd);
+
+    if (category == XED_CATEGORY_RET) {
+	bool is_far = (iclass == XED_ICLASS_RET_FAR);
+	Instruction ret {
+	    { is_far ? e_ret_far : e_ret_near, is_far ? "ret far" : "ret", Arch_x86_64 },
+	    len, ptr, Arch_x86_64
+	};
+	Expression::Ptr rsp(new RegisterAST(x86_64::rsp));
+	Expression::Ptr ret_addr(new Dereference(rsp, u64));
+
+	ret.addSuccessor(ret_addr, false, true, false, false);
+	ctx->num_fix_branch++;
+	return ret;
+    }
+
+    if (! has_disp) {
+	return makeFakeNop(len, ptr);
+    }
+
+    if (category == XED_CATEGORY_UNCOND_BR || category == XED_CATEGORY_CALL) {
+	bool is_call = (category == XED_CATEGORY_CALL);
+	Instruction ret {
+	    { is_call ? e_call : e_jmp, is_call ? "call" : "jmp", Arch_x86_64 },
+	    len, ptr, Arch_x86_64
+	};
+
+	ret.addSuccessor(makeRelTarget(len, disp), is_call, false, false, false);
+	ctx->num_fix_branch++;
+	return ret;
+    }
+
+    if (category == XED_CATEGORY_COND_BR) {
+	for (auto & ent : xed_branch_map) {
+	    if (ent.iclass == iclass) {
+		Instruction ret {
+		    { ent.id, ent.name, Arch_x86_64 },
+		    len, ptr, Arch_x86_64
+		};
+		Expression::Ptr fall_through = makeRelTarget(len, 0);
+
+		ret.addSuccessor(makeRelTarget(len, disp), false, false, true, false);
+		ret.addSuccessor(fall_through, false, false, false, true);
+		ctx->num_fix_branch++;
+		return ret;
+	    }
+	}
+    }
+
+    return makeFakeNop(len, ptr);
+}
+
+// Zero the displacement and immediate bytes of a decoded instruction
+// in bytes (a copy of its len bytes), at the positions where XED
+// found them.  They are not always the last bytes:  ENTER has a
+// second immediate and the 3DNow! opcode suffix follows the
+// displacement.  With rel_only, zero only the pc-relative parts (a
+// branch displacement or a rip-relative memory displacement).
+void
+maskDispImm(const xed_decoded_inst_t * xedd, char * bytes, int len, bool rel_only)
+{
+    struct { int pos, width; } field[3];
+
+    int disp = xed_decoded_inst_get_branch_displacement_width(xedd);
+    if (! rel_only || xed_decoded_inst_get_base_reg(xedd, 0) == XED_REG_RIP) {
+	disp = std::max(disp, (int) xed_decoded_inst_get_memory_displacement_width(xedd, 0));
+    }
+    field[0] = { (int) xed3_operand_get_pos_disp(xedd), disp };
+    field[1] = { (int) xed3_operand_get_pos_imm(xedd),
+		 rel_only ? 0 : (int) xed_decoded_inst_get_immediate_width(xedd) };
+    field[2] = { (int) xed3_operand_get_pos_imm1(xedd),
+		 rel_only ? 0 : (int) xed3_operand_get_imm1_bytes(xedd) };
+
+    for (auto & f : field) {
+	if (f.width > 0) {
+	    for (int i = std::max(f.pos, 0); i < std::min(f.pos + f.width, len); i++) {
+		bytes[i] = 0;
+	    }
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+
+// Unknown instructions that can't be matched to an analysis go to
+// stray_analysis, which is never in its initial parse, so they are
+// not counted.  With no live analysis (--diff-encodings, the decoder
+// after a parse) that is expected, with several live analyses and a
+// buffer in none of their code buffers, it is a lost record, so
+// count those and warn once.
+static Analysis stray_analysis(NULL);
+atomic <long> num_stray_callbacks(0);
+
+// Find the analysis for a callback buffer.  Try this thread's ctx
+// first, then the code buffers of all live analyses, then the only
+// live analysis.  The callback is only for unknown instructions, so
+// the lock is cheap.
+static Analysis *
+findAnalysis(const unsigned char * ptr)
+{
+    if (ctx != NULL && ctx->hasCode(ptr)) {
+	return ctx;
+    }
+
+    lock_guard <mutex> guard(analysis_mutex);
+
+    for (auto it = live_analyses.begin(); it != live_analyses.end(); ++it) {
+	if ((*it)->hasCode(ptr)) {
+	    return *it;
+	}
+    }
+    if (live_analyses.size() == 1) {
+	return live_analyses[0];
+    }
+    if (! live_analyses.empty() && num_stray_callbacks++ == 0) {
+	warnx("unknown instruction at %p is not in the code of any running analysis,"
+	      " not counted", ptr);
+    }
+    return &stray_analysis;
+}
+
+InstructionAPI::Instruction
+myXedCallback(InstructionDecoder::buffer seqn)
+{
+    uint8_t buf[MY_BUF_SIZE];
+    Instruction ret;
+
+    // set ctx for this call only, a stray buffer must not change the
+    // analysis for the rest of the thread
+    Analysis * saved_ctx = ctx;
+    ctx = findAnalysis(seqn.start);
+
+    // copy into array of uint8_t for xed
+    int buf_len = 0;
+    for (auto p = seqn.start; p != seqn.end; ++p) {
+	buf[buf_len] = (uint8_t) *p;
+	buf_len++;
+
+	if (buf_len >= MY_BUF_SIZE) {
+	    break;
+	}
+    }
+    PROBE2(callback__entry, seqn.start, buf_len);
+
+    xed_decoded_inst_t xedd;
+    xed_state_t dstate;
+    unsigned int xed_len = 0;
+    unsigned int start = 0;
+    bool is_valid = false, is_troll = false;
+
+    // test beginning of buffer
+    xed_state_zero(&dstate);
+    dstate.mmode = XED_MACHINE_MODE_LONG_64;
+    xed_decoded_inst_zero_set_mode(&xedd, &dstate);
+    int xed_error = xed_decode(&xedd, buf, buf_len);
+
+    if (xed_error == XED_ERROR_NONE) {
+	//
+	// case 1 - valid instruction at beginning of buffer
+	// return an instruction with the xed length and control flow
+	// (a fake no-op if not a relative branch, call or return)
+	//
+	xed_len = xed_decoded_inst_get_length(&xedd);
+	is_valid = true;
+	if (ctx->fix_valid && ! ctx->failed) {
+	    ret = makeXedInstruction(&xedd, xed_len, seqn.start);
+	} else {
+	    ret = Instruction{};
+	}
+    }
+    else {
+	// try trolling
+	for (start = 1; start < buf_len; start++) {
+	    xed_state_zero(&dstate);
+	    dstate.mmode = XED_MACHINE_MODE_LONG_64;
+	    xed_decoded_inst_zero_set_mode(&xedd, &dstate);
+	    xed_error = xed_decode(&xedd, buf + start, buf_len - start);
+
+	    if (xed_error == XED_ERROR_NONE) {
+		//
+		// case 2 -- out of sync instn starting at buf[start].
+		// return fake no-op and let dyninst get back in sync
+		//
+		xed_len = xed_decoded_inst_get_length(&xedd);
+		is_troll = true;
+		if (ctx->fix_troll && ! ctx->failed) {
+		    ret = makeFakeNop(start, seqn.start);
+		} else {
+		    ret = Instruction{};
+		}
+		break;
+	    }
+	}
+	if (xed_error != XED_ERROR_NONE) {
+	    //
+	    // case 3 -- not a valid instruction, trolling failed
+	    // return an invalid instruction
+	    //
+	    ret = Instruction{};
+	}
+    }
+
+    // sometime fixing trolls is dangerous, don't allow an infinite
+    // string of errors.  fail the analysis and stop fixing, so the
+    // parse winds down.
+    if (xed_error != XED_ERROR_NONE) {
+	int num = ++ctx->num_xed_errors;
+
+	if (num > 20 && ! ctx->failed) {
+	    analysisError("exceeded num xed errors: %d", num);
+	}
+    }
+    else {
+	ctx->num_xed_errors = 0;
+    }
+
+    // only count and report errors on initial parse.  splitting a
+    // block into instructions causes duplicate calls here.  with
+    // --offsets, only count the ones inside the mapped ranges, the
+    // same as phases 2 and 3.
+    bool count = ctx->initial_parse;
+
+    if (count && (ctx->offsets != NULL || ! ctx->mapped_ranges.empty())) {
+	count = inRanges(ctx->mapped_ranges, ctx->codeAddr(seqn.start));
+    }
+
+    if (count && ! opts.quiet) {
+	string line = "unknown: ";
+
+	for (int i = 0; i < buf_len; i++) {
+	    bufPrintf(line, " %02x", buf[i]);
+	}
+	if (is_valid) {
+	    bufPrintf(line, "  valid: %d%s\n", xed_len,
+		      ctx->fix_valid ? "  (fix)" : "");
+
+	}
+	else if (is_troll) {
+	    bufPrintf(line, "  troll: %d  len: %d%s\n", start, xed_len,
+		      ctx->fix_troll ? "  (fix)" : "");
+	}
+	else {
+	    line += "  error\n";
+	}
+	emitRecord(KIND_UNKNOWN, line, NULL);
+    }
+
+    if (count) {
+	ctx->lock.lock();
+	ctx->num_unknown++;
+	if (is_valid) { ctx->num_unknown_valid++; }
+	else if (is_troll) { ctx->num_unknown_troll++; }
+	else { ctx->num_unknown_error++; }
+	ctx->unknown_ptrs.push_back(seqn.start);
+	ctx->lock.unlock();
+
+	if (is_valid || is_troll) {
+	    noteProblem();
+	}
+    }
+
+    PROBE3(callback__exit, seqn.start, is_valid ? 1 : (is_troll ? 2 : 0), xed_len);
+
+    ctx = saved_ctx;
+    return ret;
+}
+
+//----------------------------------------------------------------------
+
+// XED verdict cache (--xed-cache file).
+//
+// The set of instruction byte strings where XED agreed with dyninst's
+// length.  XED's length depends only on the bytes of the instruction
+// itself, so a byte string that matched once always matches and phase
+// 2 can skip the decode.  The multi-build driver (--builds) shares
+// one cache file between its workers.
+//
+// The set is read-only during phase 2.  New verdicts are kept per
+// thread (in CheckStats) and merged into the file at the end.
+//
+#define XED_CACHE_MAGIC  "UX86XEDC"
+
+unordered_set <string> xed_cache;
+long xed_cache_loaded = 0;
+
+// With --in-process, the analyses share one cache, loaded before the
+// first file and saved after the last, so it stays read-only while
+// any phase 2 runs.  New verdicts wait in xed_pending.
+mutex xed_pending_mutex;
+unordered_set <string> xed_pending;
+
+void
+loadXedCache(const char * path)
+{
+    FILE * fp = fopen(path, "r");
+    char magic[8];
+
+    if (fp == NULL) {
+	return;
+    }
+    if (fread(magic, 1, 8, fp) != 8 || memcmp(magic, XED_CACHE_MAGIC, 8) != 0) {
+	warnx("ignoring bad xed cache file: %s", path);
+	fclose(fp);
+	return;
+    }
+
+    // records are:  length byte, then the instruction bytes
+    int len;
+    char bytes[256];
+
+    while ((len = getc(fp)) != EOF) {
+	if (len == 0 || fread(bytes, 1, len, fp) != (size_t) len) {
+	    break;
+	}
+	xed_cache.insert(string(bytes, len));
+    }
+    fclose(fp);
+
+    xed_cache_loaded = xed_cache.size();
+}
+
+// Write to a temp file and rename, so a reader never sees a partial
+// file.  If two writers race, the last one wins, which is fine for a
+// cache.
+void
+saveXedCache(const char * path, const unordered_set <string> & new_verdicts)
+{
+    xed_cache.insert(new_verdicts.begin(), new_verdicts.end());
+
+    string tmp = string(path) + ".tmp." + to_string(getpid());
+    FILE * fp = fopen(tmp.c_str(), "w");
+
+    if (fp == NULL) {
+	warn("unable to write xed cache file: %s", tmp.c_str());
+	return;
+    }
+
+    fwrite(XED_CACHE_MAGIC, 1, 8, fp);
+    for (auto it = xed_cache.begin(); it != xed_cache.end(); ++it) {
+	putc(it->size(), fp);
+	fwrite(it->data(), 1, it->size(), fp);
+    }
+
+    if (fclose(fp) != 0 || rename(tmp.c_str(), path) != 0) {
+	warn("unable to write xed cache file: %s", path);
+	unlink(tmp.c_str());
+    }
+}
+
+//----------------------------------------------------------------------
+
+// Iterate the instructions in a block and compare the length of each
+// instruction with xed's length.  Also, make sure there are no gaps
+// between instructions (rarely happens, but dyninst error if it does).
+//
+// Note: we only report one error per block.  After that, we consider
+// the block to be corrupted and not worth testing any further.  But
+// the xed sweep finds every point where dyninst and xed desync, and
+// -v lists them with the error.
+//
+// Output goes to the out buffer and counts to stats, so that blocks
+// may be checked from multiple threads.
+//
+void
+doBlock(Block * block, CheckStats & stats, string & out)
+{
+    Address block_start = block->start();
+    long block_size = block->size();
+    stats.num_bytes += block_size;
+
+    //
+    // step 1 -- malloc buffer for entire block plus one instruction
+    // in case xed length is longer than dyninst length.
+    //
+    long buf_size = block_size + 20;
+    uint8_t * buf = (uint8_t *) malloc(buf_size);
+
+    if (buf == NULL) {
+	analysisError("malloc buffer in doBlock failed, size: %ld", buf_size);
+	return;
+    }
+    memset(buf, 0, buf_size);
+
+    //
+    // step 2 -- iterate instructions and fill in buffer,
+    // check instructions are all adjacent.
+    //
+    Block::Insns imap;
+    block->getInsns(imap);
+    stats.num_instns += imap.size();
+
+    long pos = 0;
+    for (auto iit = imap.begin(); iit != imap.end(); ++iit) {
+	Address addr = iit->first;
+	Offset dyn_len = iit->second.size();
+
+	if (block_start + pos != addr) {
+	    if (! opts.quiet) {
+		string line;
+		bufPrintf(line, "block error (align): 0x%lx  offset: 0x%lx  next: 0x%lx\n",
+			  block_start, pos, addr);
+		emitRecord(KIND_BLOCK, line, &out);
+	    }
+	    stats.num_block_align_errors++;
+	    PROBE3(finding, KIND_BLOCK, block_start, 0);
+	    noteProblem();
+	    if (ctx->want_findings) {
+		stats.findings.push_back(Finding(block_start, KIND_BLOCK));
+	    }
+	    goto end_block;
+	}
+	if (pos + dyn_len > block_size) {
+	    if (! opts.quiet) {
+		string line;
+		bufPrintf(line, "block error (too long): 0x%lx  offset: 0x%lx  size: 0x%lx  len: 0x%lx\n",
+			  block_start, pos, dyn_len, block_size);
+		emitRecord(KIND_BLOCK, line, &out);
+	    }
+	    stats.num_block_length_errors++;
+	    PROBE3(finding, KIND_BLOCK, block_start, 0);
+	    noteProblem();
+	    if (ctx->want_findings) {
+		stats.findings.push_back(Finding(block_start, KIND_BLOCK));
+	    }
+	    goto end_block;
+	}
+
+	for (int n = 0; n < dyn_len; n++) {
+	    buf[pos + n] = (uint8_t) iit->second.rawByte(n);
+	}
+	pos += dyn_len;
+    }
+
+    //
+    // step 3 -- compare dyninst's instruction starts with a linear
+    // xed sweep from the block start, as two bitsets (bit n is block
+    // offset n, plus the end of the last instruction).  Up to the
+    // first differing bit, the starts agree, so the first bad length
+    // is the last dyninst start before it.  Each run of differing
+    // bits up to the next common start is one desync point.
+    //
+    // The bitsets and length arrays are per-thread scratch, reused
+    // from block to block, so there is no allocation per block.
+    //
+    {
+	static thread_local vector <uint64_t> dyn_bits;
+	static thread_local vector <uint64_t> xed_bits;
+	static thread_local vector <uint8_t> dyn_lens;
+	static thread_local vector <uint8_t> xed_lens;
+	static thread_local vector <uint8_t> cached;
+
+	long num_words = (pos + XED_MAX_INSTRUCTION_BYTES) / 64 + 1;
+	long first_error = -1;
+
+	dyn_bits.assign(num_words, 0);
+	xed_bits.assign(num_words, 0);
+	dyn_lens.assign(pos, 0);
+	xed_lens.assign(pos, 0);
+	cached.assign(pos, 0);
+
+	for (auto iit = imap.begin(); iit != imap.end(); ++iit) {
+	    long off = iit->first - block_start;
+	    dyn_bits[off / 64] |= 1UL << (off % 64);
+	    dyn_lens[off] = iit->second.size();
+	}
+	dyn_bits[pos / 64] |= 1UL << (pos % 64);
+
+	long xpos = 0;
+	while (xpos < pos) {
+	    long dyn_len = dyn_lens[xpos];
+	    xed_decoded_inst_t xedd;
+	    xed_state_t dstate;
+
+	    xed_bits[xpos / 64] |= 1UL << (xpos % 64);
+
+	    // a cached verdict is only for a dyninst start
+	    if (opts.xed_cache != NULL && dyn_len > 0
+		&& xed_cache.count(string((const char *) &buf[xpos], dyn_len)) > 0) {
+		cached[xpos] = 1;
+		xed_lens[xpos] = dyn_len;
+		xpos += dyn_len;
+		continue;
+	    }
+
+	    xed_state_zero(&dstate);
+	    dstate.mmode = XED_MACHINE_MODE_LONG_64;
+	    xed_decoded_inst_zero_set_mode(&xedd, &dstate);
+
+	    if (xed_decode(&xedd, &buf[xpos], 16) == XED_ERROR_NONE) {
+		xed_lens[xpos] = xed_decoded_inst_get_length(&xedd);
+		xpos += xed_lens[xpos];
+	    }
+	    else {
+		// an error where dyninst has a start is a bad length
+		// even if the bits happen to agree
+		if (dyn_len > 0 && first_error < 0) {
+		    first_error = xpos;
+		}
+		xpos++;
+	    }
+	}
+	xed_bits[xpos / 64] |= 1UL << (xpos % 64);
+
+	long num_diff = 0;
+
+#pragma omp simd reduction(+:num_diff)
+	for (long w = 0; w < num_words; w++) {
+	    num_diff += __builtin_popcountll(dyn_bits[w] ^ xed_bits[w]);
+	}
+
+	long bad = -1;
+	vector <Address> desync;
+
+	if (num_diff > 0) {
+	    auto isCommon = [&](long n) {
+		return (dyn_bits[n / 64] & xed_bits[n / 64] & (1UL << (n % 64))) != 0;
+	    };
+	    auto nextDiff = [&](long n) {
+		for (long w = n / 64; w < num_words; w++) {
+		    uint64_t diff = dyn_bits[w] ^ xed_bits[w];
+		    if (w == n / 64) {
+			diff &= ~ 0UL << (n % 64);
+		    }
+		    if (diff != 0) {
+			return w * 64 + __builtin_ctzll(diff);
+		    }
+		}
+		return -1L;
+	    };
+
+	    // each desync is at the last common start before a
+	    // differing bit, and lasts until the next common start
+	    long bit = nextDiff(0);
+
+	    while (bit >= 0) {
+		long start = bit - 1;
+		while (start > 0 && ! isCommon(start)) {
+		    start--;
+		}
+		desync.push_back(block_start + start);
+
+		long next = bit + 1;
+		while (next < num_words * 64 && ! isCommon(next)) {
+		    next++;
+		}
+		bit = (next < num_words * 64) ? nextDiff(next) : -1;
+	    }
+	    bad = desync.front() - block_start;
+	    stats.num_desync += desync.size();
+	}
+	if (first_error >= 0 && (bad < 0 || first_error < bad)) {
+	    bad = first_error;
+	}
+
+	// the instructions up to the first bad one are checked
+	for (auto iit = imap.begin(); iit != imap.end(); ++iit) {
+	    long off = iit->first - block_start;
+	    Offset dyn_len = iit->second.size();
+
+	    if (bad >= 0 && off > bad) {
+		break;
+	    }
+	    if (cached[off]) {
+		stats.num_cache_hits++;
+	    }
+	    if (ctx->want_bounds) {
+		stats.bounds.push_back(InsnBound(iit->first, dyn_len, xed_lens[off]));
+	    }
+	    if (off != bad && opts.xed_cache != NULL && ! cached[off]) {
+		stats.new_verdicts.insert(string((const char *) &buf[off], dyn_len));
+	    }
+	}
+
+	if (bad >= 0) {
+	    Address addr = block_start + bad;
+
+	    if (! opts.quiet) {
+		string line;
+		bufPrintf(line, "bad length at 0x%lx: ", addr);
+		for (int i = 0; i < 16; i++) {
+		    bufPrintf(line, " %02x", buf[bad + i]);
+		}
+		bufPrintf(line, "  dyn: %ld  xed: %ld\n", (long) dyn_lens[bad], (long) xed_lens[bad]);
+		if (opts.verbose && desync.size() > 1) {
+		    bufPrintf(line, "  desync at:");
+		    for (auto it = desync.begin(); it != desync.end(); ++it) {
+			bufPrintf(line, " 0x%lx", *it);
+		    }
+		    bufPrintf(line, "\n");
+		}
+		emitRecord(KIND_BAD_LENGTH, line, &out);
+	    }
+	    stats.num_bad_length++;
+	    PROBE3(finding, KIND_BAD_LENGTH, addr, 0);
+	    noteProblem();
+	    if (ctx->want_findings) {
+		stats.findings.push_back(Finding(addr, KIND_BAD_LENGTH));
+	    }
+	}
+    }
+
+ end_block:
+    free(buf);
+
+    return;
+}
+
+//----------------------------------------------------------------------
+
+// Check the blocks of one function and write its output all at once,
+// so the output from different threads doesn't interleave.
+//
+void
+doFunction(ParseAPI::Function * func, CheckStats & stats)
+{
+    string out;
+    long num_errors = stats.num_bad_length + stats.num_block_align_errors
+	+ stats.num_block_length_errors;
+
+    PROBE1(function__start, func->addr());
+
+    // get map of visited blocks and convert to vector
+    const ParseAPI::Function::blocklist & blist = func->blocks();
+    vector <Block *> blockVec;
+
+    for (auto bit = blist.begin(); bit != blist.end(); ++bit) {
+	Block * block = *bit;
+	blockVec.push_back(block);
+    }
+    stats.num_blocks += blockVec.size();
+
+    // sort by block start address
+    std::sort(blockVec.begin(), blockVec.end(), BlockLessThan);
+
+    for (long n = 0; n < blockVec.size(); n++) {
+	Block * block = blockVec[n];
+	doBlock(block, stats, out);
+    }
+
+    PROBE2(function__end, func->addr(), stats.num_bad_length + stats.num_block_align_errors
+	   + stats.num_block_length_errors - num_errors);
+
+    // flush so that findings stream out as they're found, even
+    // through a pipe
+    if (! out.empty()) {
+	print_mutex.lock();
+	fputs(out.c_str(), stdout);
+	fflush(stdout);
+	print_mutex.unlock();
+    }
+}
+
+//----------------------------------------------------------------------
+
+// Fast 64-bit hash of a byte string (multiply-rotate on 8-byte words
+// and a murmur3 finalizer).  For content change detection, this is
+// not a cryptographic hash.
+//
+uint64_t
+hashBytes(const void * data, size_t len, uint64_t seed)
+{
+    const uint8_t * p = (const uint8_t *) data;
+    uint64_t h = seed ^ (len * 0x9e3779b97f4a7c15ULL);
+    uint64_t w;
+
+    while (len >= 8) {
+	memcpy(&w, p, 8);
+	h ^= w * 0x87c37b91114253d5ULL;
+	h = ((h << 31) | (h >> 33)) * 0x4cf5ad432745937fULL;
+	p += 8;
+	len -= 8;
+    }
+    w = 0;
+    memcpy(&w, p, len);
+    h ^= w * 0x87c37b91114253d5ULL;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+// Hash of a file's contents, 0 if unreadable.
+uint64_t
+hashFile(const char * path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat sb;
+    uint64_t h = 0;
+
+    if (fd < 0) {
+	return 0;
+    }
+    if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+	void * addr = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (addr != MAP_FAILED) {
+	    madvise(addr, sb.st_size, MADV_SEQUENTIAL);
+	    h = hashBytes(addr, sb.st_size);
+	    munmap(addr, sb.st_size);
+	}
+    }
+    close(fd);
+
+    return h;
+}
+
+//----------------------------------------------------------------------
+
+// Function clones (--clones).  Libraries like MKL have many functions
+// that are the same code at different addresses (one per ISA variant
+// or entry point), so check one representative of each group and
+// copy its results to the others.
+//
+// The key is each block's offset from the entry and size, and the
+// block bytes with the relative displacements (branch targets and
+// rip-relative operands) zeroed, from a linear XED pass over each
+// block.  Dyninst and XED lengths don't depend on the displacement
+// values, and identical block layouts mean that a finding at rep +
+// offset is at clone + offset.
+//
+class CloneKey {
+public:
+    uint64_t  hash1;
+    uint64_t  hash2;
+    long  size;
+    long  code_bytes;
+
+    bool operator == (const CloneKey & other) const {
+	return hash1 == other.hash1 && hash2 == other.hash2 && size == other.size;
+    }
+};
+
+class CloneKeyHash {
+public:
+    size_t operator () (const CloneKey & key) const {
+	return key.hash1;
+    }
+};
+
+// Compute the clone key for one function, false if some block has no
+// bytes (the function is then its own group).
+static bool
+cloneKey(ParseAPI::Function * func, CodeSource * code_src, CloneKey & key)
+{
+    const ParseAPI::Function::blocklist & blist = func->blocks();
+    vector <Block *> blockVec(blist.begin(), blist.end());
+    string text;
+
+    std::sort(blockVec.begin(), blockVec.end(), BlockLessThan);
+
+    for (auto bit = blockVec.begin(); bit != blockVec.end(); ++bit) {
+	Block * block = *bit;
+	long size = block->size();
+	const uint8_t * ptr = (const uint8_t *) code_src->getPtrToInstruction(block->start());
+	int64_t layout[2] = { (int64_t) (block->start() - func->addr()), size };
+
+	if (ptr == NULL) {
+	    return false;
+	}
+	text.append((const char *) layout, sizeof(layout));
+
+	long start = text.size();
+	text.append((const char *) ptr, size);
+
+	long pos = 0;
+	while (pos < size) {
+	    xed_decoded_inst_t xedd;
+	    xed_state_t dstate;
+
+	    xed_state_zero(&dstate);
+	    dstate.mmode = XED_MACHINE_MODE_LONG_64;
+	    xed_decoded_inst_zero_set_mode(&xedd, &dstate);
+
+	    // an undecodable tail stays as raw bytes
+	    if (xed_decode(&xedd, ptr + pos, std::min(size - pos, (long) XED_MAX_INSTRUCTION_BYTES))
+		!= XED_ERROR_NONE) {
+		break;
+	    }
+
+	    int len = xed_decoded_inst_get_length(&xedd);
+	    maskDispImm(&xedd, &text[start + pos], len, true);
+	    pos += len;
+	}
+    }
+
+    key.hash1 = hashBytes(text.data(), text.size(), 1);
+    key.hash2 = hashBytes(text.data(), text.size(), 2);
+    key.size = text.size();
+    key.code_bytes = text.size() - blockVec.size() * 2 * sizeof(int64_t);
+
+    return ! blockVec.empty();
+}
+
+// Drop the clones from funcVec into checkVec (same order), so each
+// group is checked when its representative (the first function of
+// the group in funcVec order) comes up, and fill in ctx->clone_groups
+// from representative to clones.
+void
+findClones(const vector <ParseAPI::Function *> & funcVec, CodeSource * code_src,
+	   vector <ParseAPI::Function *> & checkVec)
+{
+    long num_funcs = funcVec.size();
+    vector <CloneKey> keys(num_funcs);
+    vector <char> valid(num_funcs);
+
+    double start = omp_get_wtime();
+
+#pragma omp parallel for schedule(dynamic, 16) num_threads(ctx->check_jobs)
+    for (long n = 0; n < num_funcs; n++) {
+	valid[n] = cloneKey(funcVec[n], code_src, keys[n]);
+    }
+
+    unordered_map <CloneKey, long, CloneKeyHash> groupMap;
+    vector <long> group(num_funcs, -1);
+
+    for (long n = 0; n < num_funcs; n++) {
+	if (! valid[n]) {
+	    continue;
+	}
+	auto it = groupMap.find(keys[n]);
+	if (it == groupMap.end()) {
+	    groupMap[keys[n]] = n;
+	}
+	else {
+	    group[n] = it->second;
+	    group[it->second] = it->second;
+	}
+    }
+
+    for (long n = 0; n < num_funcs; n++) {
+	if (group[n] < 0 || group[n] == n) {
+	    checkVec.push_back(funcVec[n]);
+	}
+	else {
+	    ctx->clone_groups[funcVec[group[n]]].push_back(funcVec[n]);
+	    ctx->num_clones++;
+	    ctx->clone_bytes += keys[n].code_bytes;
+	}
+    }
+
+    ctx->num_clone_groups = ctx->clone_groups.size();
+    ctx->clone_secs = omp_get_wtime() - start;
+}
+
+// Check one function for phase 2.  If it is the representative of a
+// clone group, copy its counts and findings to the clones, moved by
+// the entry address difference.  Output records are only for the
+// representative.
+static void
+checkFunction(ParseAPI::Function * func, CheckStats & stats)
+{
+    auto git = ctx->clone_groups.find(func);
+
+    if (git == ctx->clone_groups.end()) {
+	doFunction(func, stats);
+	return;
+    }
+
+    CheckStats one;
+
+    doFunction(func, one);
+    stats.add(one);
+
+    long problems = one.num_bad_length + one.num_block_align_errors
+	+ one.num_block_length_errors;
+
+    for (auto cit = git->second.begin(); cit != git->second.end(); ++cit) {
+	Address delta = (*cit)->addr() - func->addr();
+
+	stats.num_blocks += one.num_blocks;
+	stats.num_instns += one.num_instns;
+	stats.num_bytes += one.num_bytes;
+	stats.num_bad_length += one.num_bad_length;
+	stats.num_block_align_errors += one.num_block_align_errors;
+	stats.num_block_length_errors += one.num_block_length_errors;
+	stats.num_desync += one.num_desync;
+
+	for (auto fit = one.findings.begin(); fit != one.findings.end(); ++fit) {
+	    stats.findings.push_back(Finding(fit->addr + delta, fit->kind, fit->size));
+	}
+	for (auto bit = one.bounds.begin(); bit != one.bounds.end(); ++bit) {
+	    stats.bounds.push_back(InsnBound(bit->addr + delta, bit->dyn_len, bit->xed_len));
+	}
+	for (long k = 0; k < problems; k++) {
+	    noteProblem();
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+
+// Phase 2 -- check every function with ctx->check_jobs threads.
+// Functions are handed out dynamically in funcVec order (address or
+// score order).
+//
+void
+checkFunctions(vector <ParseAPI::Function *> & funcVec)
+{
+    long num_funcs = funcVec.size();
+    Analysis * an = ctx;
+    vector <CheckStats> thrStats(an->check_jobs);
+
+#pragma omp parallel num_threads(an->check_jobs)
+    {
+	CheckStats & stats = thrStats[omp_get_thread_num()];
+	Analysis * saved_ctx = ctx;
+	ctx = an;
+
+#pragma omp for schedule(dynamic, 4)
+	for (long n = 0; n < num_funcs; n++) {
+	    if (! ctx->fail_fast_stop) {
+		checkFunction(funcVec[n], stats);
+	    }
+	}
+
+	// the pool threads outlive this analysis
+	ctx = saved_ctx;
+    }
+
+    for (long n = 0; n < (long) thrStats.size(); n++) {
+	ctx->check_stats.add(thrStats[n]);
+    }
+}
+
+// Phase 2 with --numa.  Put each function in the bucket for the numa
+// node that holds its entry block (the node that built its CFG), pin
+// each thread to a node and have it drain its own node's bucket
+// first, then help the other nodes.  Keep per node throughput stats.
+//
+void
+checkFunctionsNuma(vector <ParseAPI::Function *> & funcVec)
+{
+    int num_nodes = numa_nodes.size();
+    int num_threads = ctx->check_jobs;
+    long num_funcs = funcVec.size();
+
+    vector <void *> addrs(num_funcs);
+    vector <int> index;
+
+    for (long n = 0; n < num_funcs; n++) {
+	addrs[n] = (void *) funcVec[n]->entry();
+    }
+    getPageNodes(addrs, index);
+
+    ctx->node_stats.assign(num_nodes, NodeStats());
+    vector <vector <long>> bucket(num_nodes);
+
+    for (long n = 0; n < num_funcs; n++) {
+	int k = (index[n] >= 0) ? index[n] : (n % num_nodes);
+	bucket[k].push_back(n);
+	ctx->node_stats[k].cfg_funcs++;
+    }
+
+    vector <long> next(num_nodes, 0);
+    vector <CheckStats> thrStats(num_threads);
+    vector <NodeStats> thrNode(num_threads);
+    vector <int> thrIndex(num_threads);
+    Analysis * an = ctx;
+
+#pragma omp parallel num_threads(num_threads)
+    {
+	int tid = omp_get_thread_num();
+	Analysis * saved_ctx = ctx;
+	ctx = an;
+	int node = numaThreadNode(tid);
+	CheckStats & stats = thrStats[tid];
+	NodeStats & ns = thrNode[tid];
+	double start = omp_get_wtime();
+
+	thrIndex[tid] = node;
+	pinThread(node);
+
+	for (int k = 0; k < num_nodes; k++) {
+	    int nd = (node + k) % num_nodes;
+
+	    for (;;) {
+		long i;
+#pragma omp atomic capture
+		i = next[nd]++;
+
+		if (i >= (long) bucket[nd].size() || ctx->fail_fast_stop) {
+		    break;
+		}
+		long before = stats.num_instns;
+		checkFunction(funcVec[bucket[nd][i]], stats);
+		ns.num_instns += stats.num_instns - before;
+
+		if (k == 0) { ns.local_funcs++; }
+		else { ns.remote_funcs++; }
+	    }
+	}
+	ns.thread_secs = omp_get_wtime() - start;
+	unpinThread();
+	ctx = saved_ctx;
+    }
+
+    for (int t = 0; t < num_threads; t++) {
+	NodeStats & ns = ctx->node_stats[thrIndex[t]];
+
+	ctx->check_stats.add(thrStats[t]);
+	ns.threads++;
+	ns.local_funcs += thrNode[t].local_funcs;
+	ns.remote_funcs += thrNode[t].remote_funcs;
+	ns.num_instns += thrNode[t].num_instns;
+	ns.thread_secs += thrNode[t].thread_secs;
+    }
+}
+
+//----------------------------------------------------------------------
+
+// The unknown callback only gets a buffer pointer, so map the
+// pointers back to addresses through the code regions.  This works
+// when the buffer points into the region's data (not a copy).
+//
+void
+getUnknownAddrs(CodeSource * code_src, vector <Address> & addrs)
+{
+    const vector <CodeRegion *> & regions = code_src->regions();
+
+    for (auto pit = ctx->unknown_ptrs.begin(); pit != ctx->unknown_ptrs.end(); ++pit) {
+	for (auto rit = regions.begin(); rit != regions.end(); ++rit) {
+	    CodeRegion * reg = *rit;
+	    const unsigned char * base =
+		(const unsigned char *) reg->getPtrToInstruction(reg->low());
+
+	    if (base != NULL && *pit >= base && *pit < base + (reg->high() - reg->low())) {
+		addrs.push_back(reg->low() + (*pit - base));
+		break;
+	    }
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+
+// Search for unclaimed regions (gaps) between basic blocks.  Some
+// compilers insert cold regions inside other functions, so we need to
+// analyze all blocks together.
+//
+void
+doGaps(vector <ParseAPI::Function *> & funcVec)
+{
+    // get list of all blocks and sort by start address
+    vector <Block *> blockVec;
+
+    for (auto fit = funcVec.begin(); fit != funcVec.end(); ++fit) {
+	ParseAPI::Function * func = *fit;
+	const ParseAPI::Function::blocklist & blist = func->blocks();
+
+	for (auto bit = blist.begin(); bit != blist.end(); ++bit) {
+	    Block * block = *bit;
+	    blockVec.push_back(block);
+	}
+    }
+
+    std::sort(blockVec.begin(), blockVec.end(), BlockLessThan);
+
+    if (blockVec.empty()) {
+	return;
+    }
+
+    //
+    // compare adjacent blocks
+    //
+    Block * prev_block = blockVec[0];
+    Address covered_end = prev_block->end();
+    ctx->covered_bytes = prev_block->size();
+
+    for (long n = 1; n < blockVec.size(); n++) {
+	Block * block = blockVec[n];
+	long size = block->start() - prev_block->end();
+
+	// union of all blocks, counting overlaps once
+	if (block->end() > covered_end) {
+	    ctx->covered_bytes += block->end() - std::max(block->start(), covered_end);
+	    covered_end = block->end();
+	}
+
+	if (size > 0) {
+	    if (! opts.quiet) {
+		string line;
+		bufPrintf(line, "gap: prev block: 0x%lx  end: 0x%lx  next: 0x%lx  size: 0x%lx (%ld)\n",
+			  prev_block->start(), prev_block->end(), block->start(), size, size);
+		emitRecord(KIND_GAP, line, NULL);
+	    }
+	    ctx->num_gaps++;
+	    ctx->size_gaps += size;
+	    PROBE3(finding, KIND_GAP, prev_block->end(), size);
+	    // use the last instruction before the gap, so the gap maps
+	    // to the function and line where parsing stopped
+	    if (ctx->want_findings) {
+		ctx->gap_findings.push_back(Finding(prev_block->last(), KIND_GAP, size));
+	    }
+
+	    if (size < 16) {
+		ctx->num_gaps_16++;
+		ctx->size_gaps_16 += size;
+	    }
+	    else if (size < 64) {
+		ctx->num_gaps_64++;
+		ctx->size_gaps_64 += size;
+	    }
+	    else if (size < 256) {
+		ctx->num_gaps_256++;
+		ctx->size_gaps_256 += size;
+	    }
+	    else {
+		ctx->num_gaps_other++;
+		ctx->size_gaps_other += size;
+	    }
+	}
+	else if (size < 0) {
+	    //
+	    // overlap or duplicate blocks
+	    //
+	    if (! opts.quiet) {
+		string line;
+		bufPrintf(line, "overlap: prev end: 0x%lx  begin: 0x%lx  end: 0x%lx\n",
+			  prev_block->end(), block->start(), block->end());
+		emitRecord(KIND_OVERLAP, line, NULL);
+	    }
+	    ctx->num_overlap++;
+	    PROBE3(finding, KIND_OVERLAP, block->start(), prev_block->end() - block->start());
+	    if (ctx->want_findings) {
+		ctx->gap_findings.push_back(Finding(block->start(), KIND_OVERLAP));
+	    }
+	}
+
+	prev_block = block;
+    }
+}
+
+//----------------------------------------------------------------------
+
+// Findings by function.
+//
+// Map addresses (samples or findings) to functions by sorting them
+// and merging against a sorted index of all block ranges, in one
+// pass instead of a lookup per address.
+//
+void
+buildBlockIndex(vector <ParseAPI::Function *> & funcVec)
+{
+    for (auto fit = funcVec.begin(); fit != funcVec.end(); ++fit) {
+	const ParseAPI::Function::blocklist & blist = (*fit)->blocks();
+
+	for (auto bit = blist.begin(); bit != blist.end(); ++bit) {
+	    BlockRange range;
+	    range.start = (*bit)->start();
+	    range.end = (*bit)->end();
+	    range.func = *fit;
+	    ctx->block_index.push_back(range);
+	}
+    }
+    std::sort(ctx->block_index.begin(), ctx->block_index.end());
+}
+
+//----------------------------------------------------------------------
+
+// Phase 1 for the current analysis (ctx):  parse code_obj with the
+// unknown callback counting into ctx.  The callback finds the
+// analysis by its code buffers, or through ctx in the parse threads.
+// Afterwards, the callback stays in place to be consistent for fixed
+// instructions, but stops counting unknown instructions.
+//
+void
+parseCode(CodeObject * code_obj)
+{
+    Analysis * an = ctx;
+    const vector <CodeRegion *> & codeRegs = code_obj->cs()->regions();
+
+    for (auto rit = codeRegs.begin(); rit != codeRegs.end(); ++rit) {
+	CodeRegion * reg = *rit;
+	const unsigned char * base =
+	    (const unsigned char *) reg->getPtrToInstruction(reg->low());
+
+	if (base != NULL) {
+	    an->code_ptrs.push_back(make_pair(base, base + (reg->high() - reg->low())));
+	    an->code_addrs.push_back(reg->low());
+	}
+    }
+
+    analysis_mutex.lock();
+    live_analyses.push_back(an);
+    analysis_mutex.unlock();
+
+#pragma omp parallel
+    ctx = an;
+
+    an->initial_parse = 1;
+
+    // any tbb work from the parse stays within -j slots
+    tbb::task_arena arena(an->jobs);
+
+    const char * name = (an->filename != NULL) ? an->filename : "";
+    double start = omp_get_wtime();
+    double start_cpu = cpuSecs();
+
+    PROBE2(phase__start, "parse", name);
+
+    arena.execute([code_obj] { code_obj->parse(); });
+
+    PROBE3(phase__end, "parse", name, PROBE_USECS(start));
+
+    an->parse_secs = omp_get_wtime() - start;
+    an->parse_cpu = cpuSecs() - start_cpu;
+    an->max_threads = std::max(an->max_threads, numThreads());
+
+    an->initial_parse = 0;
+
+    // the openmp pool threads outlive this analysis, so don't leave
+    // them pointing at it (this thread keeps it until endAnalysis)
+#pragma omp parallel
+    if (omp_get_thread_num() != 0) {
+	ctx = NULL;
+    }
+}
+
+// Done with the current analysis, the callback no longer sees it.
+void
+endAnalysis()
+{
+    analysis_mutex.lock();
+    live_analyses.erase(std::find(live_analyses.begin(), live_analyses.end(), ctx));
+    analysis_mutex.unlock();
+
+    ctx = NULL;
+}
+
+// Put the function list into a vector and sort by entry address.
+void
+getSortedFuncs(CodeObject * code_obj, vector <ParseAPI::Function *> & funcVec)
+{
+    const CodeObject::funclist & funcList = code_obj->funcs();
+
+    for (auto fit = funcList.begin(); fit != funcList.end(); ++fit) {
+	funcVec.push_back(*fit);
+    }
+    std::sort(funcVec.begin(), funcVec.end(), FuncLessThan);
+}
+
+//----------------------------------------------------------------------
+
+// Checker library API (see unknown-x86.h).  The same phases as
+// analyzeFile() on a caller's CodeObject, with no output, and the
+// results returned as data.  The options are per call (in the
+// Analysis), checkerInit() only sets the default options.
+//
+static once_flag checker_once;
+static mutex checker_mutex;
+static CheckerOptions checker_defaults;
+
+void
+checkerInit(const CheckerOptions & options)
+{
+    checker_mutex.lock();
+    checker_defaults = options;
+    checker_mutex.unlock();
+
+    call_once(checker_once, [] {
+	    opts.quiet = true;
+	    xed_tables_init();
+	    InstructionDecoder::unknown_instruction::register_callback(&myXedCallback);
+	});
+}
+
+long
+checkCodeObject(CodeObject * code_obj, const CheckerRanges & ranges, CheckerResult & result)
+{
+    checker_mutex.lock();
+    CheckerOptions options = checker_defaults;
+    checker_mutex.unlock();
+
+    return checkCodeObject(code_obj, ranges, options, result);
+}
+
+long
+checkCodeObject(CodeObject * code_obj, const CheckerRanges & ranges,
+		const CheckerOptions & options, CheckerResult & result)
+{
+    Analysis an(NULL);
+
+    an.jobs = options.jobs;
+    an.check_jobs = options.check_jobs;
+    an.fix_valid = options.fix_valid;
+    an.fix_troll = options.fix_troll;
+    an.want_findings = true;
+    ctx = &an;
+
+    if (! ranges.empty()) {
+	an.mapped_ranges.assign(ranges.begin(), ranges.end());
+	mergeRanges(an.mapped_ranges);
+    }
+
+    // the parse uses the calling thread's openmp setting, so set it
+    // for the parse only and give the caller back its own.  there is
+    // no tbb global_control here, that would cap the whole process,
+    // the task arena in parseCode() bounds the parse.
+    int saved_threads = omp_get_max_threads();
+
+    omp_set_num_threads(an.jobs);
+    parseCode(code_obj);
+    omp_set_num_threads(saved_threads);
+
+    vector <ParseAPI::Function *> funcVec;
+    getSortedFuncs(code_obj, funcVec);
+    buildBlockIndex(funcVec);
+
+    if (! ranges.empty()) {
+	funcVec.erase(std::remove_if(funcVec.begin(), funcVec.end(),
+			  [&an](ParseAPI::Function * func) {
+			      return ! inRanges(an.mapped_ranges, func->addr());
+			  }),
+		      funcVec.end());
+    }
+
+    double start = omp_get_wtime();
+    PROBE2(phase__start, "check", "");
+    checkFunctions(funcVec);
+    PROBE3(phase__end, "check", "", PROBE_USECS(start));
+    an.check_secs = omp_get_wtime() - start;
+
+    // an error in the parse stops phase 2 before it starts
+    if (an.failed) {
+	result.error = an.error;
+	endAnalysis();
+	return -1;
+    }
+
+    start = omp_get_wtime();
+    PROBE2(phase__start, "gaps", "");
+    doGaps(funcVec);
+    PROBE3(phase__end, "gaps", "", PROBE_USECS(start));
+    an.gaps_secs = omp_get_wtime() - start;
+
+    // all findings, sorted, with the function from the block index
+    vector <Finding> findings = an.check_stats.findings;
+    vector <Address> unknownAddrs;
+    vector <Address> addrs;
+
+    getUnknownAddrs(code_obj->cs(), unknownAddrs);
+    for (auto it = unknownAddrs.begin(); it != unknownAddrs.end(); ++it) {
+	findings.push_back(Finding(*it, KIND_UNKNOWN));
+    }
+    findings.insert(findings.end(), an.gap_findings.begin(), an.gap_findings.end());
+    std::sort(findings.begin(), findings.end(), FindingLessThan);
+
+    result.findings.resize(findings.size());
+
+    for (long n = 0; n < (long) findings.size(); n++) {
+	CheckerFinding & cf = result.findings[n];
+
+	cf.addr = findings[n].addr;
+	cf.func = 0;
+	cf.kind = findings[n].kind;
+	cf.size = findings[n].size;
+	addrs.push_back(findings[n].addr);
+    }
+    mergeBlockIndex(addrs,
+		    [&findings](long n) { return findings[n].kind == KIND_UNKNOWN; },
+		    [&result](ParseAPI::Function * func, long n) {
+			result.findings[n].funcs.push_back(func->addr());
+		    });
+
+    for (auto it = result.findings.begin(); it != result.findings.end(); ++it) {
+	if (! it->funcs.empty()) {
+	    std::sort(it->funcs.begin(), it->funcs.end());
+	    it->func = it->funcs[0];
+	}
+    }
+
+    CheckStats & cs = an.check_stats;
+
+    result.funcs = funcVec.size();
+    result.blocks = cs.num_blocks;
+    result.instns = cs.num_instns;
+    result.bytes = cs.num_bytes;
+    result.covered_bytes = an.covered_bytes;
+    result.unknown = an.num_unknown;
+    result.unknown_valid = an.num_unknown_valid;
+    result.unknown_troll = an.num_unknown_troll;
+    result.unknown_error = an.num_unknown_error;
+    result.bad_length = cs.num_bad_length;
+    result.block_errors = cs.num_block_align_errors + cs.num_block_length_errors;
+    result.gaps = an.num_gaps;
+    result.gap_bytes = an.size_gaps;
+    result.overlap = an.num_overlap;
+    result.parse_secs = an.parse_secs;
+    result.check_secs = an.check_secs;
+    result.gaps_secs = an.gaps_secs;
+
+    long problems = an.num_problems;
+    endAnalysis();
+
+    return problems;
+}
@@ -0,0 +1,1443 @@
+//
+//  Copyright (c) 2023, Rice University
+//  All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//  
+//  1. Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//  
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//  
+//  3. Neither the name of the copyright holder nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------
+//
+//  Corpus modes:  --corpus, --maps and --archive, with the
+//  checkpoint journal and --in-process.
+//
+// ----------------------------------------------------------------------
+
+#include "unknown-x86-internal.h"
+
+//----------------------------------------------------------------------
+
+// Corpus mode:  --corpus  dir-or-list
+//
+// Analyze every ELF file under a directory (recursive) or every file
+// named in a list file (one per line).  Each file is analyzed in a
+// forked child process, so a dyninst crash only loses that one file,
+// and up to --corpus-jobs children run at once.  The child's results
+// come back as key=value lines (--kv-out).
+//
+// With --checkpoint file, each completed file is appended to a journal
+// (content hash, options, status and results), and --resume skips
+// files whose hash and options match a journal record.  The journal is
+// fsync'd in batches.
+//
+
+// Return true if path is a regular file that begins with the ELF magic.
+static bool
+isElfFile(const char * path)
+{
+    char magic[4];
+    int fd = open(path, O_RDONLY);
+    bool ans = false;
+
+    if (fd >= 0) {
+	ans = (read(fd, magic, 4) == 4 && memcmp(magic, "\177ELF", 4) == 0);
+	close(fd);
+    }
+    return ans;
+}
+
+// Recursive walk for ELF files, don't follow symlinks.
+static void
+findElfFiles(const string & dirname, vector <string> & paths)
+{
+    DIR * dir = opendir(dirname.c_str());
+    struct dirent * ent;
+
+    if (dir == NULL) {
+	warn("unable to open directory: %s", dirname.c_str());
+	return;
+    }
+    while ((ent = readdir(dir)) != NULL) {
+	string name(ent->d_name);
+	string path = dirname + "/" + name;
+	struct stat sb;
+
+	if (name == "." || name == ".." || lstat(path.c_str(), &sb) != 0) {
+	    continue;
+	}
+	if (S_ISDIR(sb.st_mode)) {
+	    findElfFiles(path, paths);
+	}
+	else if (S_ISREG(sb.st_mode) && isElfFile(path.c_str())) {
+	    paths.push_back(path);
+	}
+    }
+    closedir(dir);
+}
+
+void
+getCorpusFiles(const char * arg, vector <string> & paths)
+{
+    struct stat sb;
+
+    if (stat(arg, &sb) != 0) {
+	err(1, "unable to stat: %s", arg);
+    }
+    if (S_ISDIR(sb.st_mode)) {
+	findElfFiles(arg, paths);
+	std::sort(paths.begin(), paths.end());
+	return;
+    }
+
+    FILE * fp = fopen(arg, "r");
+    char line[4096];
+
+    if (fp == NULL) {
+	err(1, "unable to open list file: %s", arg);
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	string path(line);
+	while (! path.empty() && isspace(path.back())) {
+	    path.pop_back();
+	}
+	if (! path.empty() && path[0] != '#') {
+	    paths.push_back(path);
+	}
+    }
+    fclose(fp);
+}
+
+//----------------------------------------------------------------------
+
+// Process maps (--maps).
+//
+// Read /proc/pid/maps (or a saved copy), take the executable,
+// file-backed mappings, and use those files as the corpus, each one
+// restricted to its mapped file offsets (--offsets).  The same
+// library can be mapped by several paths (symlinks, containers), so
+// dedupe by the ELF build-id and merge the offset ranges.
+//
+
+// Return the GNU build-id from the PT_NOTE segments as hex, or the
+// empty string if none.
+static string
+getBuildId(const string & path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat sb;
+    string ans;
+
+    if (fd < 0) {
+	return ans;
+    }
+    if (fstat(fd, &sb) != 0 || sb.st_size < (off_t) sizeof(Elf64_Ehdr)) {
+	close(fd);
+	return ans;
+    }
+    size_t size = sb.st_size;
+    void * addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+	return ans;
+    }
+    const char * buf = (const char *) addr;
+    Elf64_Ehdr ehdr;
+    memcpy(&ehdr, buf, sizeof(ehdr));
+
+    if (memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0
+	|| ehdr.e_ident[EI_CLASS] != ELFCLASS64
+	|| ehdr.e_phoff + ehdr.e_phnum * sizeof(Elf64_Phdr) > size) {
+	munmap(addr, size);
+	return ans;
+    }
+
+    for (int n = 0; n < ehdr.e_phnum && ans.empty(); n++) {
+	Elf64_Phdr phdr;
+	memcpy(&phdr, buf + ehdr.e_phoff + n * sizeof(Elf64_Phdr), sizeof(phdr));
+
+	if (phdr.p_type != PT_NOTE || phdr.p_offset + phdr.p_filesz > size) {
+	    continue;
+	}
+	size_t pos = phdr.p_offset;
+	size_t end = pos + phdr.p_filesz;
+
+	while (pos + sizeof(Elf64_Nhdr) <= end) {
+	    Elf64_Nhdr nhdr;
+	    memcpy(&nhdr, buf + pos, sizeof(nhdr));
+
+	    size_t name = pos + sizeof(nhdr);
+	    size_t desc = name + ((nhdr.n_namesz + 3) & ~3);
+	    size_t next = desc + ((nhdr.n_descsz + 3) & ~3);
+
+	    if (next > end) {
+		break;
+	    }
+	    if (nhdr.n_type == NT_GNU_BUILD_ID && nhdr.n_namesz == 4
+		&& memcmp(buf + name, "GNU", 4) == 0) {
+		for (size_t k = 0; k < nhdr.n_descsz; k++) {
+		    bufPrintf(ans, "%02x", (unsigned char) buf[desc + k]);
+		}
+		break;
+	    }
+	    pos = next;
+	}
+    }
+    munmap(addr, size);
+
+    return ans;
+}
+
+static void
+getMapsFiles(const char * arg, vector <string> & paths, map <string, string> & ranges)
+{
+    string maps_path(arg);
+    bool is_pid = ! maps_path.empty();
+
+    for (auto ch : maps_path) {
+	is_pid = is_pid && isdigit(ch);
+    }
+    if (is_pid) {
+	maps_path = "/proc/" + maps_path + "/maps";
+    }
+
+    FILE * fp = fopen(maps_path.c_str(), "r");
+    char line[4096];
+    map <string, RangeList> fileRanges;
+    long num_maps = 0;
+    long num_deleted = 0;
+
+    if (fp == NULL) {
+	err(1, "unable to open maps file: %s", maps_path.c_str());
+    }
+
+    // start-end perms offset dev inode pathname
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	unsigned long lo, hi, offset, inode;
+	char perms[8], dev[32];
+	int pos = 0;
+
+	if (sscanf(line, "%lx-%lx %7s %lx %31s %lu %n",
+		   &lo, &hi, perms, &offset, dev, &inode, &pos) < 6) {
+	    continue;
+	}
+	string path(line + pos);
+	while (! path.empty() && isspace(path.back())) {
+	    path.pop_back();
+	}
+	if (strlen(perms) < 3 || perms[2] != 'x' || inode == 0
+	    || path.empty() || path[0] != '/') {
+	    continue;
+	}
+	if (path.size() > 10 && path.compare(path.size() - 10, 10, " (deleted)") == 0) {
+	    num_deleted++;
+	    continue;
+	}
+	fileRanges[path].push_back(make_pair(offset, offset + (hi - lo)));
+	num_maps++;
+    }
+    fclose(fp);
+
+    // dedupe by build-id, the first path (sorted) represents the file
+    map <string, string> idPath;
+    map <string, RangeList> keepRanges;
+    long num_dups = 0;
+
+    for (auto it = fileRanges.begin(); it != fileRanges.end(); ++it) {
+	const string & path = it->first;
+
+	if (! isElfFile(path.c_str())) {
+	    warnx("skipping mapped file (missing or not ELF): %s", path.c_str());
+	    continue;
+	}
+	string id = getBuildId(path);
+	if (id.empty()) {
+	    id = "path:" + path;
+	}
+
+	auto iit = idPath.find(id);
+	if (iit == idPath.end()) {
+	    idPath[id] = path;
+	    keepRanges[path] = it->second;
+	    paths.push_back(path);
+	}
+	else {
+	    RangeList & rl = keepRanges[iit->second];
+	    rl.insert(rl.end(), it->second.begin(), it->second.end());
+	    num_dups++;
+	}
+    }
+
+    for (auto it = keepRanges.begin(); it != keepRanges.end(); ++it) {
+	string spec;
+
+	mergeRanges(it->second);
+	for (auto rit = it->second.begin(); rit != it->second.end(); ++rit) {
+	    bufPrintf(spec, "%s0x%lx-0x%lx", spec.empty() ? "" : ",", rit->first, rit->second);
+	}
+	ranges[it->first] = spec;
+    }
+
+    printf("\nmaps: %s  exec mappings: %ld  files: %ld  duplicates: %ld  deleted: %ld\n",
+	   maps_path.c_str(), num_maps, (long) paths.size(), num_dups, num_deleted);
+}
+
+// Append-only checkpoint journal.  One line per file:
+//   hash  options  status  path  key=value ...
+// (tab separated, key=value pairs separated by spaces, and backslash,
+// tab and newline in the path escaped as \\, \t and \n).  A partial
+// last line from a crash has no newline:  it is ignored on resume and
+// cut off when the journal is reopened, so that the next record
+// starts on a line of its own.
+//
+#define JOURNAL_SYNC_RECORDS  32
+#define JOURNAL_SYNC_SECS     10.0
+
+static string
+escapePath(const string & path)
+{
+    string ans;
+
+    for (auto it = path.begin(); it != path.end(); ++it) {
+	if (*it == '\\') { ans += "\\\\"; }
+	else if (*it == '\t') { ans += "\\t"; }
+	else if (*it == '\n') { ans += "\\n"; }
+	else { ans += *it; }
+    }
+    return ans;
+}
+
+static string
+unescapePath(const string & str)
+{
+    string ans;
+
+    for (long n = 0; n < (long) str.size(); n++) {
+	if (str[n] == '\\' && n + 1 < (long) str.size()) {
+	    n++;
+	    ans += (str[n] == 't') ? '\t' : (str[n] == 'n') ? '\n' : str[n];
+	}
+	else {
+	    ans += str[n];
+	}
+    }
+    return ans;
+}
+
+// True if the child analyzed the file to the end (exit 0).  Resume
+// only skips these, failed or killed files (eg, OOM) run again.
+static bool
+statusOK(int status)
+{
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+class Journal {
+public:
+    FILE * fp;
+    long  pending;
+    double  last_sync;
+
+    Journal() {
+	fp = NULL;
+	pending = 0;
+	last_sync = 0.0;
+    }
+
+    void open(const char * path) {
+	fp = fopen(path, "a+");
+	if (fp == NULL) {
+	    err(1, "unable to open checkpoint file: %s", path);
+	}
+
+	// back up to the last newline and truncate there
+	struct stat sb;
+	if (fstat(fileno(fp), &sb) == 0 && sb.st_size > 0) {
+	    off_t pos = sb.st_size;
+
+	    while (pos > 0) {
+		fseeko(fp, pos - 1, SEEK_SET);
+		if (getc(fp) == '\n') {
+		    break;
+		}
+		pos--;
+	    }
+	    if (pos < sb.st_size) {
+		warnx("dropping partial record at end of checkpoint file: %s", path);
+		if (ftruncate(fileno(fp), pos) != 0) {
+		    err(1, "unable to truncate checkpoint file: %s", path);
+		}
+	    }
+	    fseeko(fp, 0, SEEK_END);
+	}
+	last_sync = omp_get_wtime();
+    }
+
+    void sync() {
+	if (fp != NULL && pending > 0) {
+	    fflush(fp);
+	    fsync(fileno(fp));
+	    pending = 0;
+	    last_sync = omp_get_wtime();
+	}
+    }
+
+    void append(const CorpusFile & cf, const string & key) {
+	if (fp == NULL) {
+	    return;
+	}
+	fprintf(fp, "%016lx\t%s\t%d\t%s\t", (unsigned long) cf.hash, key.c_str(),
+		cf.status, escapePath(cf.path).c_str());
+	for (auto it = cf.result.begin(); it != cf.result.end(); ++it) {
+	    if (it->first != "file") {
+		fprintf(fp, " %s=%s", it->first.c_str(), it->second.c_str());
+	    }
+	}
+	fprintf(fp, "\n");
+	fflush(fp);
+	pending++;
+
+	if (pending >= JOURNAL_SYNC_RECORDS
+	    || omp_get_wtime() - last_sync >= JOURNAL_SYNC_SECS) {
+	    sync();
+	}
+    }
+
+    void close() {
+	sync();
+	if (fp != NULL) {
+	    fclose(fp);
+	    fp = NULL;
+	}
+    }
+};
+
+// Read the journal into a map from path to record.  Later records for
+// the same path replace earlier ones.  Malformed lines (eg, two
+// records run together by a crash) are skipped with a warning.
+static void
+readJournal(const char * path, map <string, CorpusFile> & done)
+{
+    FILE * fp = fopen(path, "r");
+    char * line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+
+    if (fp == NULL) {
+	return;
+    }
+    while ((len = getline(&line, &line_size, fp)) > 0) {
+	if (line[len - 1] != '\n') {
+	    break;
+	}
+	line[len - 1] = 0;
+
+	vector <string> field;
+	char * p = line;
+	for (int k = 0; k < 4; k++) {
+	    char * tab = strchr(p, '\t');
+	    if (tab == NULL) {
+		break;
+	    }
+	    *tab = 0;
+	    field.push_back(p);
+	    p = tab + 1;
+	}
+	char * hash_end = NULL;
+	char * status_end = NULL;
+	unsigned long hash = 0;
+	long status = 0;
+
+	if (field.size() == 4) {
+	    hash = strtoul(field[0].c_str(), &hash_end, 16);
+	    status = strtol(field[2].c_str(), &status_end, 10);
+	}
+	if (field.size() != 4 || field[0].size() != 16 || *hash_end != 0
+	    || field[1].empty() || field[2].empty() || *status_end != 0
+	    || field[3].empty() || strchr(p, '\t') != NULL) {
+	    warnx("skipping malformed line in checkpoint file: %s", path);
+	    continue;
+	}
+
+	CorpusFile cf;
+	cf.hash = hash;
+	cf.status = status;
+	cf.path = unescapePath(field[3]);
+	cf.result["options"] = field[1];
+
+	char * save = NULL;
+	for (char * tok = strtok_r(p, " ", &save); tok != NULL; tok = strtok_r(NULL, " ", &save)) {
+	    char * eq = strchr(tok, '=');
+	    if (eq != NULL) {
+		*eq = 0;
+		cf.result[tok] = eq + 1;
+	    }
+	}
+	done[cf.path] = cf;
+    }
+    free(line);
+    fclose(fp);
+}
+
+// In-process corpus (--in-process).
+//
+// Analyze the files in threads of this process instead of forked
+// children, each with its own Analysis, to skip the process startup
+// and share the XED tables and cache.  There is no crash isolation:
+// a dyninst crash or a fatal error in one file ends the run (use
+// --checkpoint and --resume).  The analyses' output goes to
+// /dev/null, and the corpus lines go to a copy of stdout.
+//
+static mutex inproc_mutex;
+static condition_variable inproc_cv;
+static vector <pair <pid_t, int>> inproc_done;
+static pid_t inproc_next_id = 1;
+static FILE * corpus_out = NULL;
+static int saved_stdout = -1;
+
+static void
+startInProcess()
+{
+    if (opts.xed_cache != NULL) {
+	loadXedCache(opts.xed_cache);
+    }
+    opts.quiet = true;
+
+    fflush(stdout);
+    saved_stdout = dup(1);
+    corpus_out = fdopen(dup(1), "w");
+
+    int fd = open("/dev/null", O_WRONLY);
+
+    if (saved_stdout < 0 || corpus_out == NULL || fd < 0) {
+	err(1, "unable to redirect stdout");
+    }
+    dup2(fd, 1);
+    close(fd);
+}
+
+static void
+endInProcess()
+{
+    if (opts.xed_cache != NULL) {
+	saveXedCache(opts.xed_cache, xed_pending);
+    }
+
+    fflush(stdout);
+    dup2(saved_stdout, 1);
+    close(saved_stdout);
+    fclose(corpus_out);
+    corpus_out = NULL;
+}
+
+// Child side:  analyze one file with output to /dev/null.
+static void
+corpusChild(const string & path, const string & ranges, const char * kv_path,
+	    char * image, size_t image_size)
+{
+    int fd = open("/dev/null", O_WRONLY);
+
+    if (fd >= 0) {
+	dup2(fd, 1);
+	dup2(fd, 2);
+	close(fd);
+    }
+    opts.quiet = true;
+
+    Analysis an(path.c_str());
+    an.offsets = ranges.empty() ? NULL : ranges.c_str();
+    an.kv_out = kv_path;
+    an.mem_image = image;
+    an.mem_image_size = image_size;
+
+    int ret = analyzeFile(an);
+    fflush(stdout);
+    _exit(ret);
+}
+
+// Start the analysis of one file, in a forked child or a thread with
+// --in-process, return its pid (or thread id) and kv file.  Takes
+// the in-memory image, if any, and frees it.
+pid_t
+startCorpusChild(const string & path, const string & ranges, string & kv_path,
+		 char * image, size_t image_size)
+{
+    char tmp[] = "/tmp/unknown-x86-kv-XXXXXX";
+    int fd = mkstemp(tmp);
+
+    if (fd < 0) {
+	err(1, "mkstemp failed");
+    }
+    close(fd);
+    kv_path = tmp;
+
+    if (opts.in_process) {
+	pid_t id = inproc_next_id++;
+	string kv(tmp);
+
+	thread thr([=]() {
+		Analysis an(path.c_str());
+		an.offsets = ranges.empty() ? NULL : ranges.c_str();
+		an.kv_out = kv.c_str();
+		an.mem_image = image;
+		an.mem_image_size = image_size;
+
+		int ret = analyzeFile(an);
+		free(image);
+
+		inproc_mutex.lock();
+		inproc_done.push_back(make_pair(id, W_EXITCODE(ret, 0)));
+		inproc_mutex.unlock();
+		inproc_cv.notify_one();
+	    });
+	thr.detach();
+
+	return id;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+
+    if (pid < 0) {
+	err(1, "fork failed");
+    }
+    if (pid == 0) {
+	corpusChild(path, ranges, tmp, image, image_size);
+    }
+    free(image);
+
+    return pid;
+}
+
+// Wait for any child, or any thread with --in-process.
+static pid_t
+waitCorpusChild(int * status)
+{
+    if (opts.in_process) {
+	unique_lock <mutex> lock(inproc_mutex);
+
+	inproc_cv.wait(lock, [] { return ! inproc_done.empty(); });
+
+	pid_t id = inproc_done.back().first;
+	*status = inproc_done.back().second;
+	inproc_done.pop_back();
+
+	return id;
+    }
+    return waitpid(-1, status, 0);
+}
+
+// Wait for one child and read its results into files.  Return the
+// index of the file, or -1 for an unknown pid or EINTR.
+static long
+reapCorpusChild(vector <CorpusFile> & files, map <pid_t, long> & running,
+		map <pid_t, string> & kv_files, map <pid_t, double> & start_time)
+{
+    int status = 0;
+    pid_t pid = waitCorpusChild(&status);
+
+    if (pid < 0) {
+	if (errno == EINTR) {
+	    return -1;
+	}
+	err(1, "waitpid failed");
+    }
+    if (running.find(pid) == running.end()) {
+	return -1;
+    }
+
+    long n = running[pid];
+    CorpusFile & cf = files[n];
+
+    cf.status = status;
+    cf.secs = omp_get_wtime() - start_time[pid];
+    readKeyValues(kv_files[pid].c_str(), cf.result);
+    cf.result["wall_secs"] = to_string(cf.secs);
+    unlink(kv_files[pid].c_str());
+
+    running.erase(pid);
+    kv_files.erase(pid);
+    start_time.erase(pid);
+
+    return n;
+}
+
+void
+printCorpusLine(const CorpusFile & cf, long num, long total)
+{
+    map <string, string> kv = cf.result;
+    string state;
+
+    if (cf.resumed) {
+	state = "resumed";
+    }
+    else if (statusOK(cf.status)) {
+	state = "ok";
+    }
+    else if (WIFSIGNALED(cf.status)) {
+	state = "FAILED (signal " + to_string(WTERMSIG(cf.status)) + ")";
+    }
+    else {
+	state = "FAILED (exit " + to_string(WEXITSTATUS(cf.status)) + ")";
+    }
+
+    char count[100];
+
+    if (total > 0) {
+	snprintf(count, sizeof(count), "[%ld/%ld]", num, total);
+    }
+    else {
+	snprintf(count, sizeof(count), "[%ld]", num);
+    }
+
+    FILE * fp = (corpus_out != NULL) ? corpus_out : stdout;
+
+    fprintf(fp, "%s %-8s  funcs: %s  unknown: %s  bad: %s  gaps: %s  %.1f sec  %s\n",
+	    count, state.c_str(),
+	    kv["funcs"].empty() ? "-" : kv["funcs"].c_str(),
+	    kv["unknown"].empty() ? "-" : kv["unknown"].c_str(),
+	    kv["bad_length"].empty() ? "-" : kv["bad_length"].c_str(),
+	    kv["gaps"].empty() ? "-" : kv["gaps"].c_str(),
+	    cf.secs, cf.path.c_str());
+    fflush(fp);
+}
+
+// Totals over all files in corpus mode.
+void
+printCorpusSummary(vector <CorpusFile> & files)
+{
+    long total = files.size();
+
+    long num_ok = 0, num_failed = 0, num_resumed = 0;
+    long funcs = 0, instns = 0, unknown = 0, bad = 0, gaps = 0;
+    double secs = 0.0;
+
+    for (long n = 0; n < total; n++) {
+	CorpusFile & cf = files[n];
+
+	if (cf.resumed) {
+	    num_resumed++;
+	}
+	if (statusOK(cf.status)) {
+	    num_ok++;
+	}
+	else {
+	    num_failed++;
+	}
+	funcs += atol(cf.result["funcs"].c_str());
+	instns += atol(cf.result["instns"].c_str());
+	unknown += atol(cf.result["unknown"].c_str());
+	bad += atol(cf.result["bad_length"].c_str());
+	gaps += atol(cf.result["gaps"].c_str());
+	secs += cf.secs;
+    }
+
+    printf("\nSummary:\n\ncorpus: %s\n", opts.filename);
+    printf("\nfiles: %ld  ok: %ld  failed: %ld  resumed: %ld\n",
+	   total, num_ok, num_failed, num_resumed);
+    printf("\nfuncs: %ld  instns: %ld  unknown: %ld  bad length: %ld  gaps: %ld\n",
+	   funcs, instns, unknown, bad, gaps);
+    printf("\nfile time: %.1f sec\n", secs);
+
+    if (num_stray_callbacks > 0) {
+	printf("\nstray unknown callbacks (not counted): %ld\n", (long) num_stray_callbacks);
+    }
+
+    if (num_failed > 0) {
+	printf("\nfailed files:\n");
+	for (long n = 0; n < total; n++) {
+	    if (! statusOK(files[n].status)) {
+		printf("  %s\n", files[n].path.c_str());
+	    }
+	}
+    }
+    cout << endl;
+}
+
+int
+runCorpus()
+{
+    vector <string> paths;
+    map <string, string> ranges;
+    map <string, CorpusFile> done;
+    Journal journal;
+    string key = optionsKey();
+
+    if (opts.maps) {
+	getMapsFiles(opts.filename, paths, ranges);
+    }
+    else {
+	getCorpusFiles(opts.filename, paths);
+    }
+
+    if (opts.resume) {
+	readJournal(opts.checkpoint, done);
+    }
+    if (opts.checkpoint != NULL) {
+	journal.open(opts.checkpoint);
+    }
+
+    long total = paths.size();
+    vector <CorpusFile> files(total);
+    vector <long> todo;
+    long num_done = 0;
+
+    cout << "\ncorpus: " << total << " files  jobs: " << opts.corpus_jobs << endl << endl;
+
+    for (long n = 0; n < total; n++) {
+	CorpusFile & cf = files[n];
+
+	cf.path = paths[n];
+	cf.ranges = ranges[cf.path];
+	if (opts.checkpoint != NULL) {
+	    cf.hash = hashFile(cf.path.c_str());
+	}
+
+	auto it = done.find(cf.path);
+	if (it != done.end() && it->second.hash == cf.hash
+	    && statusOK(it->second.status)
+	    && it->second.result["options"] == key
+	    && it->second.result["offsets"] == cf.ranges) {
+	    cf.result = it->second.result;
+	    cf.status = it->second.status;
+	    cf.secs = atof(cf.result["wall_secs"].c_str());
+	    cf.resumed = true;
+	    num_done++;
+	    printCorpusLine(cf, num_done, total);
+	}
+	else {
+	    todo.push_back(n);
+	}
+    }
+
+    // run up to corpus_jobs children at once
+    map <pid_t, long> running;
+    map <pid_t, string> kv_files;
+    map <pid_t, double> start_time;
+    long next = 0;
+
+    if (opts.in_process) {
+	startInProcess();
+    }
+
+    while (next < (long) todo.size() || ! running.empty()) {
+	while (next < (long) todo.size() && (long) running.size() < opts.corpus_jobs) {
+	    long n = todo[next++];
+	    string kv_path;
+	    pid_t pid = startCorpusChild(files[n].path, files[n].ranges, kv_path);
+
+	    running[pid] = n;
+	    kv_files[pid] = kv_path;
+	    start_time[pid] = omp_get_wtime();
+	}
+
+	long n = reapCorpusChild(files, running, kv_files, start_time);
+
+	if (n >= 0) {
+	    journal.append(files[n], key);
+	    num_done++;
+	    printCorpusLine(files[n], num_done, total);
+	}
+    }
+    journal.close();
+
+    if (opts.in_process) {
+	endInProcess();
+    }
+
+    printCorpusSummary(files);
+
+    return 0;
+}
+
+//----------------------------------------------------------------------
+
+// Archive mode:  --archive  pkg.tar[.gz]|pkg.cpio|pkg.rpm|-
+//
+// Stream a tar or cpio archive (newc or odc), or the cpio payload of
+// an rpm, optionally gzip'd, from a file or stdin, and analyze each
+// ELF member in memory.  Nothing is extracted to disk:  the member is
+// read into a buffer, and the forked child opens it with
+// Symtab::openFile() on the buffer (the child gets its own copy of the
+// pages from fork).  The members are named archive:member, and
+// --checkpoint and --resume work the same as in corpus mode, with the
+// hash of the member's bytes.
+//
+// xz, zstd and bzip2 payloads are not supported, use rpm2cpio or the
+// decompressor on the command line and read stdin (-).
+//
+#define ARCHIVE_BUF_SIZE  (1024 * 1024)
+
+#define FORMAT_TAR        0
+#define FORMAT_CPIO_NEWC  1
+#define FORMAT_CPIO_ODC   2
+
+// Byte stream from a file or stdin, with the rpm lead and headers
+// skipped and gunzip'd if the payload has the gzip magic.
+class ArchiveStream {
+public:
+    int   fd;
+    bool  gzip;
+    bool  zeof;
+    z_stream  zs;
+    unsigned char * raw;
+    size_t  raw_pos;
+    size_t  raw_len;
+    size_t  raw_used;
+    long  pos;
+
+    ArchiveStream() {
+	fd = -1;
+	gzip = false;
+	zeof = false;
+	memset(&zs, 0, sizeof(zs));
+	raw = new unsigned char[ARCHIVE_BUF_SIZE];
+	raw_pos = 0;
+	raw_len = 0;
+	raw_used = 0;
+	pos = 0;
+    }
+
+    ~ArchiveStream() {
+	if (gzip) {
+	    inflateEnd(&zs);
+	}
+	delete [] raw;
+    }
+
+    // Make len bytes available at raw + raw_pos (len is small), return
+    // false at eof.
+    bool peek(size_t len) {
+	if (raw_len - raw_pos >= len) {
+	    return true;
+	}
+	memmove(raw, raw + raw_pos, raw_len - raw_pos);
+	raw_len -= raw_pos;
+	raw_pos = 0;
+
+	while (raw_len < len) {
+	    ssize_t ret = ::read(fd, raw + raw_len, ARCHIVE_BUF_SIZE - raw_len);
+	    if (ret < 0 && errno == EINTR) {
+		continue;
+	    }
+	    if (ret < 0) {
+		err(1, "read failed: %s", opts.filename);
+	    }
+	    if (ret == 0) {
+		return false;
+	    }
+	    raw_len += ret;
+	}
+	return true;
+    }
+
+    // Raw read (before gunzip), return number of bytes read.
+    size_t rawRead(unsigned char * buf, size_t len) {
+	size_t done = 0;
+
+	while (done < len && peek(1)) {
+	    size_t amt = min(len - done, raw_len - raw_pos);
+	    if (buf != NULL) {
+		memcpy(buf + done, raw + raw_pos, amt);
+	    }
+	    raw_pos += amt;
+	    done += amt;
+	}
+	raw_used += done;
+	return done;
+    }
+
+    void rawSkip(size_t len) {
+	if (rawRead(NULL, len) != len) {
+	    errx(1, "truncated rpm header: %s", opts.filename);
+	}
+    }
+
+    // Skip one rpm header structure (signature or main header).
+    void skipRpmHeader() {
+	unsigned char intro[16];
+
+	if (rawRead(intro, 16) != 16 || memcmp(intro, "\x8e\xad\xe8\x01", 4) != 0) {
+	    errx(1, "bad rpm header: %s", opts.filename);
+	}
+	size_t nindex = ((size_t) intro[8] << 24) | (intro[9] << 16) | (intro[10] << 8) | intro[11];
+	size_t hsize = ((size_t) intro[12] << 24) | (intro[13] << 16) | (intro[14] << 8) | intro[15];
+
+	rawSkip(16 * nindex + hsize);
+    }
+
+    void open(const char * path) {
+	if (strcmp(path, "-") == 0) {
+	    fd = 0;
+	}
+	else {
+	    fd = ::open(path, O_RDONLY);
+	    if (fd < 0) {
+		err(1, "unable to open: %s", path);
+	    }
+	}
+
+	// rpm:  96-byte lead, signature header padded to 8 bytes, main
+	// header, then the (compressed) cpio payload
+	if (peek(4) && memcmp(raw + raw_pos, "\xed\xab\xee\xdb", 4) == 0) {
+	    rawSkip(96);
+	    skipRpmHeader();
+	    if (raw_used % 8 != 0) {
+		rawSkip(8 - raw_used % 8);
+	    }
+	    skipRpmHeader();
+	}
+
+	if (peek(6)) {
+	    const unsigned char * p = raw + raw_pos;
+
+	    if (p[0] == 0x1f && p[1] == 0x8b) {
+		gzip = true;
+		if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+		    errx(1, "inflateInit failed");
+		}
+	    }
+	    else if (memcmp(p, "\xfd" "7zXZ", 5) == 0) {
+		errx(1, "xz compression is not supported, use: xz -dc %s | unknown-x86 --archive -",
+		     opts.filename);
+	    }
+	    else if (memcmp(p, "\x28\xb5\x2f\xfd", 4) == 0) {
+		errx(1, "zstd compression is not supported, use: zstd -dc %s | unknown-x86 --archive -",
+		     opts.filename);
+	    }
+	    else if (memcmp(p, "BZh", 3) == 0) {
+		errx(1, "bzip2 compression is not supported, use: bzip2 -dc %s | unknown-x86 --archive -",
+		     opts.filename);
+	    }
+	}
+    }
+
+    // Read len bytes of archive data (after gunzip), buf may be NULL
+    // to skip.  Return number of bytes read, short only at eof.
+    size_t read(unsigned char * buf, size_t len) {
+	size_t done = 0;
+
+	if (! gzip) {
+	    done = rawRead(buf, len);
+	    pos += done;
+	    return done;
+	}
+
+	unsigned char scratch[64 * 1024];
+
+	while (done < len && ! zeof) {
+	    if (raw_pos == raw_len && ! peek(1)) {
+		errx(1, "truncated gzip data: %s", opts.filename);
+	    }
+	    size_t amt = len - done;
+	    if (buf == NULL && amt > sizeof(scratch)) {
+		amt = sizeof(scratch);
+	    }
+	    zs.next_in = raw + raw_pos;
+	    zs.avail_in = raw_len - raw_pos;
+	    zs.next_out = (buf != NULL) ? buf + done : scratch;
+	    zs.avail_out = amt;
+
+	    int ret = inflate(&zs, Z_NO_FLUSH);
+
+	    raw_pos = raw_len - zs.avail_in;
+	    done += amt - zs.avail_out;
+
+	    if (ret == Z_STREAM_END) {
+		// concatenated gzip members
+		if (peek(1)) {
+		    inflateReset(&zs);
+		}
+		else {
+		    zeof = true;
+		}
+	    }
+	    else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+		errx(1, "gzip error (%d): %s", ret, opts.filename);
+	    }
+	}
+	pos += done;
+	return done;
+    }
+};
+
+// Parse an octal or hex number from a fixed-width header field.
+static unsigned long
+headerNumber(const unsigned char * field, int len, int base)
+{
+    char buf[32];
+
+    len = min(len, (int) sizeof(buf) - 1);
+    memcpy(buf, field, len);
+    buf[len] = 0;
+
+    return strtoul(buf, NULL, base);
+}
+
+// tar size field, octal or gnu base-256.
+static unsigned long
+tarSize(const unsigned char * hdr)
+{
+    if (hdr[124] & 0x80) {
+	unsigned long size = 0;
+	for (int k = 125; k < 136; k++) {
+	    size = (size << 8) | hdr[k];
+	}
+	return size;
+    }
+    return headerNumber(hdr + 124, 12, 8);
+}
+
+static bool
+tarChecksumOK(const unsigned char * hdr)
+{
+    unsigned long sum = 0;
+
+    for (int k = 0; k < 512; k++) {
+	sum += (k >= 148 && k < 156) ? ' ' : hdr[k];
+    }
+    return sum == headerNumber(hdr + 148, 8, 8);
+}
+
+// Find path= in a pax extended header.  Records are "len key=value\n".
+static string
+paxPath(const string & data)
+{
+    size_t off = 0;
+
+    while (off < data.size()) {
+	size_t len = strtoul(data.c_str() + off, NULL, 10);
+	size_t sp = data.find(' ', off);
+
+	if (len == 0 || sp == string::npos || off + len > data.size()) {
+	    break;
+	}
+	string rec = data.substr(sp + 1, off + len - sp - 2);
+	if (rec.compare(0, 5, "path=") == 0) {
+	    return rec.substr(5);
+	}
+	off += len;
+    }
+    return "";
+}
+
+// Iterate over the regular file members of an archive.
+class ArchiveReader {
+public:
+    ArchiveStream  in;
+    int  format;
+    long  num_members;
+
+    ArchiveReader() {
+	format = FORMAT_TAR;
+	num_members = 0;
+    }
+
+    // the format is sniffed from each header in nextHeader()
+    void open(const char * path) {
+	in.open(path);
+    }
+
+    void skip(unsigned long len) {
+	if (in.read(NULL, len) != len) {
+	    errx(1, "truncated archive: %s", opts.filename);
+	}
+    }
+
+    void readString(string & str, unsigned long len) {
+	str.resize(len);
+	if (in.read((unsigned char *) &str[0], len) != len) {
+	    errx(1, "truncated archive: %s", opts.filename);
+	}
+    }
+
+    void align(long size) {
+	if (in.pos % size != 0) {
+	    skip(size - in.pos % size);
+	}
+    }
+
+    // Read the next regular member's header, return false at the end.
+    bool nextHeader(string & name, unsigned long & size);
+
+    // Next regular member.  If it begins with the ELF magic, read it
+    // into data (malloc'd, the caller frees), else skip it and set
+    // data to NULL.  Return false at the end of the archive.
+    bool next(string & name, char * & data, unsigned long & size) {
+	if (! nextHeader(name, size)) {
+	    return false;
+	}
+	num_members++;
+
+	unsigned char magic[4];
+	unsigned long len = min(size, 4UL);
+
+	data = NULL;
+	if (in.read(magic, len) != len) {
+	    errx(1, "truncated archive: %s", opts.filename);
+	}
+	if (len == 4 && memcmp(magic, "\177ELF", 4) == 0) {
+	    data = (char *) malloc(size);
+	    if (data == NULL) {
+		errx(1, "out of memory for member: %s (%lu bytes)", name.c_str(), size);
+	    }
+	    memcpy(data, magic, 4);
+	    if (in.read((unsigned char *) data + 4, size - 4) != size - 4) {
+		errx(1, "truncated archive: %s", opts.filename);
+	    }
+	}
+	else {
+	    skip(size - len);
+	}
+	align(format == FORMAT_TAR ? 512 : (format == FORMAT_CPIO_NEWC ? 4 : 1));
+
+	// rpm and cpio names begin with ./
+	if (name.compare(0, 2, "./") == 0) {
+	    name = name.substr(2);
+	}
+	return true;
+    }
+};
+
+bool
+ArchiveReader::nextHeader(string & name, unsigned long & size)
+{
+    string long_name;
+
+    for (;;) {
+	unsigned char hdr[512];
+	size_t len = in.read(hdr, 6);
+
+	if (len == 0) {
+	    return false;
+	}
+	if (len != 6) {
+	    errx(1, "truncated archive: %s", opts.filename);
+	}
+
+	// cpio newc (070701, 070702 with crc):  110-byte hex header,
+	// name and data padded to 4 bytes
+	if (memcmp(hdr, "07070", 5) == 0 && (hdr[5] == '1' || hdr[5] == '2')) {
+	    format = FORMAT_CPIO_NEWC;
+	    if (in.read(hdr + 6, 104) != 104) {
+		errx(1, "truncated archive: %s", opts.filename);
+	    }
+	    unsigned long mode = headerNumber(hdr + 14, 8, 16);
+	    size = headerNumber(hdr + 54, 8, 16);
+	    unsigned long namesize = headerNumber(hdr + 94, 8, 16);
+
+	    readString(name, namesize);
+	    name.resize(strnlen(name.c_str(), namesize));
+	    align(4);
+
+	    if (name == "TRAILER!!!") {
+		return false;
+	    }
+	    if ((mode & S_IFMT) == S_IFREG) {
+		return true;
+	    }
+	    skip(size);
+	    align(4);
+	    continue;
+	}
+
+	// cpio odc (070707):  76-byte octal header, no padding
+	if (memcmp(hdr, "070707", 6) == 0) {
+	    format = FORMAT_CPIO_ODC;
+	    if (in.read(hdr + 6, 70) != 70) {
+		errx(1, "truncated archive: %s", opts.filename);
+	    }
+	    unsigned long mode = headerNumber(hdr + 18, 6, 8);
+	    unsigned long namesize = headerNumber(hdr + 59, 6, 8);
+	    size = headerNumber(hdr + 65, 11, 8);
+
+	    readString(name, namesize);
+	    name.resize(strnlen(name.c_str(), namesize));
+
+	    if (name == "TRAILER!!!") {
+		return false;
+	    }
+	    if ((mode & S_IFMT) == S_IFREG) {
+		return true;
+	    }
+	    skip(size);
+	    continue;
+	}
+
+	// tar:  512-byte header, data padded to 512 bytes, ends with a
+	// zero block
+	format = FORMAT_TAR;
+	if (in.read(hdr + 6, 506) != 506) {
+	    errx(1, "truncated archive: %s", opts.filename);
+	}
+	if (hdr[0] == 0) {
+	    return false;
+	}
+	if (! tarChecksumOK(hdr)) {
+	    errx(1, "not a tar, cpio or rpm file (bad header at %ld): %s",
+		 in.pos - 512, opts.filename);
+	}
+
+	char type = hdr[156];
+	size = tarSize(hdr);
+
+	// gnu long name and pax path apply to the next header
+	if (type == 'L' || type == 'x') {
+	    string data;
+	    readString(data, size);
+	    align(512);
+	    if (type == 'L') {
+		long_name = string(data.c_str());
+	    }
+	    else if (! paxPath(data).empty()) {
+		long_name = paxPath(data);
+	    }
+	    continue;
+	}
+	if (type != '0' && type != 0 && type != '7') {
+	    skip(size);
+	    align(512);
+	    long_name.clear();
+	    continue;
+	}
+
+	if (! long_name.empty()) {
+	    name = long_name;
+	}
+	else {
+	    name = string((const char *) hdr, strnlen((const char *) hdr, 100));
+	    if (memcmp(hdr + 257, "ustar", 5) == 0 && hdr[345] != 0) {
+		name = string((const char *) hdr + 345, strnlen((const char *) hdr + 345, 155))
+		    + "/" + name;
+	    }
+	}
+	return true;
+    }
+}
+
+int
+runArchive()
+{
+    ArchiveReader archive;
+    map <string, CorpusFile> done;
+    Journal journal;
+    string key = optionsKey();
+
+    archive.open(opts.filename);
+
+    if (opts.resume) {
+	readJournal(opts.checkpoint, done);
+    }
+    if (opts.checkpoint != NULL) {
+	journal.open(opts.checkpoint);
+    }
+
+    cout << "\narchive: " << opts.filename << "  jobs: " << opts.corpus_jobs << endl << endl;
+
+    if (opts.in_process) {
+	startInProcess();
+    }
+
+    // the total isn't known until the end, so the lines are [n]
+    vector <CorpusFile> files;
+    map <pid_t, long> running;
+    map <pid_t, string> kv_files;
+    map <pid_t, double> start_time;
+    long num_done = 0;
+    long num_skipped = 0;
+    long elf_bytes = 0;
+    string name;
+    unsigned long size;
+    char * data;
+
+    while (archive.next(name, data, size)) {
+	if (data == NULL) {
+	    num_skipped++;
+	    continue;
+	}
+
+	CorpusFile cf;
+	cf.path = string(opts.filename) + ":" + name;
+	cf.hash = hashBytes(data, size);
+	elf_bytes += size;
+
+	auto it = done.find(cf.path);
+	if (it != done.end() && it->second.hash == cf.hash
+	    && statusOK(it->second.status)
+	    && it->second.result["options"] == key) {
+	    cf.result = it->second.result;
+	    cf.status = it->second.status;
+	    cf.secs = atof(cf.result["wall_secs"].c_str());
+	    cf.resumed = true;
+	    files.push_back(cf);
+	    num_done++;
+	    printCorpusLine(cf, num_done, 0);
+	    free(data);
+	    continue;
+	}
+
+	while ((long) running.size() >= opts.corpus_jobs) {
+	    long n = reapCorpusChild(files, running, kv_files, start_time);
+
+	    if (n >= 0) {
+		journal.append(files[n], key);
+		num_done++;
+		printCorpusLine(files[n], num_done, 0);
+	    }
+	}
+
+	files.push_back(cf);
+	long n = files.size() - 1;
+	string kv_path;
+
+	// the child inherits the buffer through fork
+	pid_t pid = startCorpusChild(files[n].path, "", kv_path, data, size);
+
+	running[pid] = n;
+	kv_files[pid] = kv_path;
+	start_time[pid] = omp_get_wtime();
+    }
+
+    while (! running.empty()) {
+	long n = reapCorpusChild(files, running, kv_files, start_time);
+
+	if (n >= 0) {
+	    journal.append(files[n], key);
+	    num_done++;
+	    printCorpusLine(files[n], num_done, 0);
+	}
+    }
+    journal.close();
+
+    if (opts.in_process) {
+	endInProcess();
+    }
+
+    printf("\narchive members: %ld  elf: %ld (%.1f MB)  other: %ld\n",
+	   archive.num_members, (long) files.size(), elf_bytes / 1048576.0, num_skipped);
+
+    printCorpusSummary(files);
+
+    return 0;
+}
@@ -0,0 +1,341 @@
+//
+//  Copyright (c) 2023, Rice University
+//  All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//  
+//  1. Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//  
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//  
+//  3. Neither the name of the copyright holder nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------
+//
+//  Encoding-set diff (--diff-encodings).
+//
+// ----------------------------------------------------------------------
+
+#include "unknown-x86-internal.h"
+
+//----------------------------------------------------------------------
+
+// Encoding-set diff:  --diff-encodings old-file new-file
+//
+// Linear sweep the code regions of both files with XED and collect
+// the set of distinct encodings with the displacement and immediate
+// bytes masked out (zero).  The sweep restarts at every function
+// symbol to stay in sync, which also splits the work into chunks for
+// the openmp threads.  Then run the dyninst decoder on one example of
+// each encoding that is new in the second file.  The exit status is 2
+// if any new encoding is unknown to dyninst or has a bad length.
+//
+// This is much faster than a full parse of both files, but a linear
+// sweep also decodes any data in the text section.
+//
+class EncInfo {
+public:
+    long  count;
+    Address  addr;
+    int   xed_len;
+    int   raw_len;
+    uint8_t  raw[XED_MAX_INSTRUCTION_BYTES];
+};
+
+typedef unordered_map <string, EncInfo> EncodingSet;
+
+class SweepChunk {
+public:
+    const uint8_t * base;
+    Address  start;
+    long  size;
+    long  avail;
+};
+
+class SweepStats {
+public:
+    long  num_instns;
+    long  num_bad_bytes;
+    long  num_distinct;
+
+    SweepStats() {
+	num_instns = 0;
+	num_bad_bytes = 0;
+	num_distinct = 0;
+    }
+};
+
+// Add one encoding to the set, keep the lowest address as example.
+static void
+addEncoding(EncodingSet & set, const string & key, const EncInfo & info)
+{
+    auto ret = set.emplace(key, info);
+
+    if (! ret.second) {
+	EncInfo & old = ret.first->second;
+	long count = old.count + info.count;
+
+	if (info.addr < old.addr) {
+	    old = info;
+	}
+	old.count = count;
+    }
+}
+
+// Linear sweep one chunk with XED.  Avail is the number of bytes that
+// may be read (to the end of the region), size is the sweep length.
+static void
+sweepChunk(const SweepChunk & chunk, EncodingSet & set, long & num_instns, long & num_bad)
+{
+    long pos = 0;
+
+    while (pos < chunk.size) {
+	const uint8_t * ptr = chunk.base + pos;
+	long avail = std::min(chunk.avail - pos, (long) XED_MAX_INSTRUCTION_BYTES);
+	xed_decoded_inst_t xedd;
+	xed_state_t dstate;
+
+	xed_state_zero(&dstate);
+	dstate.mmode = XED_MACHINE_MODE_LONG_64;
+	xed_decoded_inst_zero_set_mode(&xedd, &dstate);
+
+	if (xed_decode(&xedd, ptr, avail) != XED_ERROR_NONE) {
+	    num_bad++;
+	    pos++;
+	    continue;
+	}
+
+	int len = xed_decoded_inst_get_length(&xedd);
+	string key((const char *) ptr, len);
+	maskDispImm(&xedd, &key[0], len, false);
+
+	EncInfo info;
+	info.count = 1;
+	info.addr = chunk.start + pos;
+	info.xed_len = len;
+	info.raw_len = avail;
+	memcpy(info.raw, ptr, avail);
+
+	addEncoding(set, key, info);
+	num_instns++;
+	pos += len;
+    }
+}
+
+// Open one file and collect its encoding set with opts.jobs threads.
+static void
+collectEncodings(const char * filename, EncodingSet & set, SweepStats & stats)
+{
+    Symtab * symtab = NULL;
+
+    cout << "\nsweeping file: " << filename << " ..." << endl;
+
+    if (! Symtab::openFile(symtab, filename)) {
+	errx(1, "Symtab::openFile (on disk) failed: %s", filename);
+    }
+
+    vector <Region *> regions;
+    vector <SymtabAPI::Function *> symFuncs;
+
+    symtab->getCodeRegions(regions);
+    symtab->getAllFunctions(symFuncs);
+
+    // split each code region at every function symbol
+    vector <SweepChunk> chunks;
+
+    for (auto rit = regions.begin(); rit != regions.end(); ++rit) {
+	Region * reg = *rit;
+	const uint8_t * base = (const uint8_t *) reg->getPtrToRawData();
+	Address low = reg->getMemOffset();
+	Address high = low + reg->getDiskSize();
+	vector <Address> starts;
+
+	if (base == NULL || high <= low) {
+	    continue;
+	}
+
+	starts.push_back(low);
+	for (auto fit = symFuncs.begin(); fit != symFuncs.end(); ++fit) {
+	    Address addr = (*fit)->getOffset();
+	    if (low < addr && addr < high) {
+		starts.push_back(addr);
+	    }
+	}
+	std::sort(starts.begin(), starts.end());
+	starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+	starts.push_back(high);
+
+	for (long n = 0; n + 1 < (long) starts.size(); n++) {
+	    SweepChunk chunk;
+	    chunk.base = base + (starts[n] - low);
+	    chunk.start = starts[n];
+	    chunk.size = starts[n + 1] - starts[n];
+	    chunk.avail = high - starts[n];
+	    chunks.push_back(chunk);
+	}
+    }
+
+    long num_chunks = chunks.size();
+    long num_instns = 0;
+    long num_bad = 0;
+    vector <EncodingSet> thrSet(opts.jobs);
+
+#pragma omp parallel for schedule(dynamic, 16) num_threads(opts.jobs) \
+    reduction(+:num_instns, num_bad)
+    for (long n = 0; n < num_chunks; n++) {
+	sweepChunk(chunks[n], thrSet[omp_get_thread_num()], num_instns, num_bad);
+    }
+
+    for (long t = 0; t < (long) thrSet.size(); t++) {
+	for (auto it = thrSet[t].begin(); it != thrSet[t].end(); ++it) {
+	    addEncoding(set, it->first, it->second);
+	}
+	thrSet[t].clear();
+    }
+
+    stats.num_instns = num_instns;
+    stats.num_bad_bytes = num_bad;
+    stats.num_distinct = set.size();
+}
+
+// Sort new encodings by count, high to low.
+static bool
+EncCountGreater(const EncInfo * e1, const EncInfo * e2)
+{
+    if (e1->count != e2->count) {
+	return e1->count > e2->count;
+    }
+    return e1->addr < e2->addr;
+}
+
+int
+diffEncodings()
+{
+    EncodingSet old_set, new_set;
+    SweepStats old_stats, new_stats;
+
+    // only for the output record counts and samples
+    Analysis an(opts.filename);
+    ctx = &an;
+
+    collectEncodings(opts.diff_old, old_set, old_stats);
+    collectEncodings(opts.filename, new_set, new_stats);
+
+    vector <EncInfo *> added;
+    long added_instns = 0;
+    long num_common = 0;
+
+    for (auto it = new_set.begin(); it != new_set.end(); ++it) {
+	if (old_set.find(it->first) == old_set.end()) {
+	    added.push_back(&it->second);
+	    added_instns += it->second.count;
+	}
+	else {
+	    num_common++;
+	}
+    }
+    std::sort(added.begin(), added.end(), EncCountGreater);
+
+    cout << "\nchecking new encodings with dyninst ..." << endl << endl;
+
+    // dyninst decoder on one example of each new encoding
+    long num_added = added.size();
+    long num_ok = 0;
+    long num_unknown = 0;
+    long num_bad = 0;
+    vector <string> lines(num_added);
+    vector <int> kinds(num_added, -1);
+
+#pragma omp parallel for schedule(dynamic, 64) num_threads(opts.jobs) \
+    reduction(+:num_ok, num_unknown, num_bad)
+    for (long n = 0; n < num_added; n++) {
+	EncInfo * info = added[n];
+	InstructionDecoder dec(info->raw, info->raw_len, Arch_x86_64);
+	Instruction insn = dec.decode();
+	long dyn_len = insn.isValid() ? insn.size() : 0;
+	string & line = lines[n];
+
+	if (! insn.isValid()) {
+	    bufPrintf(line, "new unknown at 0x%lx: ", info->addr);
+	    kinds[n] = KIND_UNKNOWN;
+	    num_unknown++;
+	}
+	else if (dyn_len != info->xed_len) {
+	    bufPrintf(line, "new bad length at 0x%lx: ", info->addr);
+	    kinds[n] = KIND_BAD_LENGTH;
+	    num_bad++;
+	}
+	else {
+	    num_ok++;
+	    if (! opts.verbose) {
+		continue;
+	    }
+	    bufPrintf(line, "new ok at 0x%lx: ", info->addr);
+	}
+	for (int i = 0; i < info->raw_len && i < 16; i++) {
+	    bufPrintf(line, " %02x", info->raw[i]);
+	}
+	bufPrintf(line, "  count: %ld  dyn: %ld  xed: %d\n",
+		  info->count, dyn_len, info->xed_len);
+    }
+
+    // print in count order, ok lines are only for -v
+    if (! opts.quiet) {
+	for (long n = 0; n < num_added; n++) {
+	    if (kinds[n] >= 0) {
+		emitRecord(kinds[n], lines[n], NULL);
+	    }
+	    else if (! lines[n].empty()) {
+		fputs(lines[n].c_str(), stdout);
+	    }
+	}
+	printSamples(KIND_UNKNOWN);
+	printSamples(KIND_BAD_LENGTH);
+    }
+
+    printf("\nSummary:\n");
+
+    printf("\nold file: %s\n"
+	   "instns: %ld  encodings: %ld  undecodable bytes: %ld\n",
+	   opts.diff_old, old_stats.num_instns, old_stats.num_distinct,
+	   old_stats.num_bad_bytes);
+
+    printf("\nnew file: %s\n"
+	   "instns: %ld  encodings: %ld  undecodable bytes: %ld\n",
+	   opts.filename, new_stats.num_instns, new_stats.num_distinct,
+	   new_stats.num_bad_bytes);
+
+    printf("\ncommon encodings: %ld  removed: %ld  new: %ld  (instns: %ld)\n",
+	   num_common, old_stats.num_distinct - num_common, num_added, added_instns);
+
+    printf("\nnew encodings:  ok: %ld  unknown: %ld  bad length: %ld\n",
+	   num_ok, num_unknown, num_bad);
+
+    printRecordCounts();
+
+    printf("\nnew release: %s\n",
+	   (num_unknown == 0 && num_bad == 0) ? "no new dyninst problems" : "NEW PROBLEMS");
+
+    cout << endl;
+
+    ctx = NULL;
+
+    return (num_unknown > 0 || num_bad > 0) ? 2 : 0;
+}
@@ -0,0 +1,382 @@
+//
+//  Copyright (c) 2023, Rice University
+//  All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//  
+//  1. Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//  
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//  
+//  3. Neither the name of the copyright holder nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------
+//
+//  Performance history (--history) and the regression report
+//  (--history-report).
+//
+// ----------------------------------------------------------------------
+
+#include "unknown-x86-internal.h"
+
+//----------------------------------------------------------------------
+
+// Performance history (--history file) and regression report
+// (--history-report file).
+//
+// Each run appends one line to the history file, tab-separated
+// key=value pairs:  time, file (path and content hash), host, dyninst
+// build (libparseAPI path and build-id), options key, threads,
+// per-phase secs, peak RSS and counts.  A single write() with O_APPEND, so corpus
+// children can share the file.
+//
+// The report groups the records into series with the same file
+// contents, host, offsets, options and thread counts, in time order, and looks
+// for change points in parse, check and gaps secs, peak RSS and
+// coverage by binary segmentation:  split each segment at the point
+// with the largest Welch t statistic between the two sides, keep it
+// if t >= HIST_T_CRIT and the change is big enough (per metric), and
+// recurse on both sides.  The build at the change point is the suspect.
+//
+#define HIST_MIN_SEG   3
+#define HIST_T_CRIT    4.0
+
+class HistRecord {
+public:
+    map <string, string> kv;
+    long  time;
+
+    double get(const string & key) const {
+	auto it = kv.find(key);
+	return (it != kv.end()) ? atof(it->second.c_str()) : 0.0;
+    }
+
+    string str(const string & key) const {
+	auto it = kv.find(key);
+	return (it != kv.end()) ? it->second : string("");
+    }
+};
+
+// One metric for the report.  Worse is +1 if bigger is worse, -1 if
+// smaller is worse.  A change must be at least min_abs and min_rel
+// (fraction) to report, and min_abs / 4 is also the floor on the std
+// dev, so that a run of identical values doesn't make any difference
+// significant.
+class HistMetric {
+public:
+    const char * key;
+    const char * units;
+    int     worse;
+    double  min_abs;
+    double  min_rel;
+};
+
+static const HistMetric hist_metrics[] = {
+    { "parse_secs",  "sec",  1,  0.05,   0.05 },
+    { "check_secs",  "sec",  1,  0.05,   0.05 },
+    { "gaps_secs",   "sec",  1,  0.05,   0.05 },
+    { "maxrss_kb",   "KB",   1,  1024.0, 0.05 },
+    { "coverage",    "%",   -1,  0.1,    0.0 },
+};
+
+// Find the loaded libparseAPI and its GNU build-id (from the PT_NOTE
+// segments in memory).
+static int
+findDyninstLib(struct dl_phdr_info * info, size_t, void * data)
+{
+    pair <string, string> * ans = (pair <string, string> *) data;
+
+    if (info->dlpi_name == NULL || strstr(info->dlpi_name, "libparseAPI") == NULL) {
+	return 0;
+    }
+    ans->first = info->dlpi_name;
+
+    for (int n = 0; n < info->dlpi_phnum; n++) {
+	const ElfW(Phdr) & phdr = info->dlpi_phdr[n];
+
+	if (phdr.p_type != PT_NOTE) {
+	    continue;
+	}
+	const char * ptr = (const char *) (info->dlpi_addr + phdr.p_vaddr);
+	const char * end = ptr + phdr.p_memsz;
+
+	while (ptr + sizeof(ElfW(Nhdr)) <= end) {
+	    const ElfW(Nhdr) * note = (const ElfW(Nhdr) *) ptr;
+	    const uint8_t * desc = (const uint8_t *) (ptr + sizeof(ElfW(Nhdr))
+						      + ((note->n_namesz + 3) & ~3));
+
+	    if (note->n_type == NT_GNU_BUILD_ID && (const char *) desc + note->n_descsz <= end) {
+		char hex[3];
+		for (long i = 0; i < (long) note->n_descsz; i++) {
+		    snprintf(hex, sizeof(hex), "%02x", desc[i]);
+		    ans->second += hex;
+		}
+		return 1;
+	    }
+	    ptr = (const char *) desc + ((note->n_descsz + 3) & ~3);
+	}
+    }
+    return 1;
+}
+
+// Append this run's record to the history file.
+void
+appendHistory(const char * path, long num_funcs)
+{
+    struct rusage usage;
+    char host[256];
+    pair <string, string> dyninst("static", "unknown");
+    string line;
+
+    getrusage(RUSAGE_SELF, &usage);
+    if (gethostname(host, sizeof(host)) != 0) {
+	strcpy(host, "unknown");
+    }
+    host[sizeof(host) - 1] = 0;
+    dl_iterate_phdr(findDyninstLib, &dyninst);
+    if (dyninst.second.empty()) {
+	dyninst.second = "unknown";
+    }
+
+    uint64_t hash = (ctx->mem_image != NULL)
+	? hashBytes(ctx->mem_image, ctx->mem_image_size) : hashFile(ctx->filename);
+
+    bufPrintf(line, "time=%ld\tfile=%s\tfile_hash=%016lx\thost=%s\tdyninst=%s\tbuild=%s"
+	      "\toffsets=%s\toptions=%s\tjobs=%d\tcheck_jobs=%d",
+	      (long) time(NULL), ctx->filename, (unsigned long) hash, host,
+	      dyninst.first.c_str(), dyninst.second.c_str(),
+	      (ctx->offsets != NULL) ? ctx->offsets : "all", optionsKey().c_str(),
+	      opts.jobs, opts.check_jobs);
+
+    // rusage is for the whole process in-process
+    bufPrintf(line, "\tparse_secs=%.3f\tcheck_secs=%.3f\tgaps_secs=%.3f\tmaxrss_kb=%ld",
+	      ctx->parse_secs, ctx->check_secs, ctx->gaps_secs,
+	      opts.in_process ? 0L : (long) usage.ru_maxrss);
+
+    bufPrintf(line, "\tfuncs=%ld\tinstns=%ld\tcoverage=%.3f\tunknown=%ld\tbad_length=%ld"
+	      "\tgaps=%ld\n",
+	      num_funcs, ctx->check_stats.num_instns,
+	      (ctx->code_bytes > 0) ? 100.0 * ctx->covered_bytes / ctx->code_bytes : 0.0,
+	      ctx->num_unknown, ctx->check_stats.num_bad_length, ctx->num_gaps);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+	warn("unable to open history file: %s", path);
+	return;
+    }
+    if (write(fd, line.data(), line.size()) != (ssize_t) line.size()) {
+	warn("write failed for history file: %s", path);
+    }
+    close(fd);
+}
+
+// Welch t statistic between vals[lo, mid) and vals[mid, hi).
+static double
+welchT(const vector <double> & vals, long lo, long mid, long hi, double floor,
+       double & mean1, double & mean2)
+{
+    double sum1 = 0.0, sum2 = 0.0, sq1 = 0.0, sq2 = 0.0;
+    long n1 = mid - lo, n2 = hi - mid;
+
+    for (long i = lo; i < mid; i++) {
+	sum1 += vals[i];
+    }
+    for (long i = mid; i < hi; i++) {
+	sum2 += vals[i];
+    }
+    mean1 = sum1 / n1;
+    mean2 = sum2 / n2;
+
+    for (long i = lo; i < mid; i++) {
+	sq1 += (vals[i] - mean1) * (vals[i] - mean1);
+    }
+    for (long i = mid; i < hi; i++) {
+	sq2 += (vals[i] - mean2) * (vals[i] - mean2);
+    }
+
+    double var1 = std::max(sq1 / (n1 - 1), floor * floor);
+    double var2 = std::max(sq2 / (n2 - 1), floor * floor);
+    double se = sqrt(var1 / n1 + var2 / n2);
+
+    return (se > 0.0) ? (mean2 - mean1) / se : 0.0;
+}
+
+class ChangePoint {
+public:
+    long    index;
+    double  before;
+    double  after;
+    double  tstat;
+};
+
+// Binary segmentation of vals[lo, hi), add change points to ans.
+static void
+findChanges(const vector <double> & vals, long lo, long hi, const HistMetric & metric,
+	    vector <ChangePoint> & ans)
+{
+    if (hi - lo < 2 * HIST_MIN_SEG) {
+	return;
+    }
+
+    ChangePoint best;
+    best.index = -1;
+    best.tstat = 0.0;
+
+    for (long mid = lo + HIST_MIN_SEG; mid <= hi - HIST_MIN_SEG; mid++) {
+	double mean1, mean2;
+	double tstat = welchT(vals, lo, mid, hi, metric.min_abs / 4, mean1, mean2);
+
+	if (fabs(tstat) > fabs(best.tstat)) {
+	    best.index = mid;
+	    best.before = mean1;
+	    best.after = mean2;
+	    best.tstat = tstat;
+	}
+    }
+
+    double diff = fabs(best.after - best.before);
+
+    if (best.index < 0 || fabs(best.tstat) < HIST_T_CRIT || diff < metric.min_abs
+	|| diff < metric.min_rel * fabs(best.before)) {
+	return;
+    }
+    ans.push_back(best);
+    findChanges(vals, lo, best.index, metric, ans);
+    findChanges(vals, best.index, hi, metric, ans);
+}
+
+// --history-report:  print the change points in every series, exit
+// status 2 if there are any regressions (for cron and ci scripts).
+int
+historyReport(const char * path)
+{
+    FILE * fp = fopen(path, "r");
+    char buf[8192];
+    vector <HistRecord> records;
+
+    if (fp == NULL) {
+	err(1, "unable to open history file: %s", path);
+    }
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+	HistRecord rec;
+	char * save = NULL;
+
+	buf[strcspn(buf, "\r\n")] = 0;
+	for (char * tok = strtok_r(buf, "\t", &save); tok != NULL;
+	     tok = strtok_r(NULL, "\t", &save)) {
+	    char * eq = strchr(tok, '=');
+	    if (eq != NULL) {
+		rec.kv[string(tok, eq - tok)] = string(eq + 1);
+	    }
+	}
+	if (rec.kv.count("time") > 0 && rec.kv.count("file") > 0) {
+	    rec.time = atol(rec.str("time").c_str());
+	    records.push_back(rec);
+	}
+    }
+    fclose(fp);
+
+    // series key:  file contents, host, offsets, options and threads
+    map <string, vector <long>> series;
+
+    for (long n = 0; n < (long) records.size(); n++) {
+	HistRecord & rec = records[n];
+	string key = rec.str("file") + "\t" + rec.str("file_hash") + "\t" + rec.str("host")
+	    + "\t" + rec.str("offsets") + "\t" + rec.str("options")
+	    + "\t" + rec.str("jobs") + "\t" + rec.str("check_jobs");
+	series[key].push_back(n);
+    }
+
+    printf("\nhistory: %s  records: %ld  series: %ld\n", path, (long) records.size(),
+	   (long) series.size());
+
+    long num_regress = 0;
+    long num_improve = 0;
+    long num_short = 0;
+
+    for (auto sit = series.begin(); sit != series.end(); ++sit) {
+	vector <long> & idx = sit->second;
+
+	std::stable_sort(idx.begin(), idx.end(),
+			 [&records](long a, long b) { return records[a].time < records[b].time; });
+
+	if ((long) idx.size() < 2 * HIST_MIN_SEG) {
+	    num_short++;
+	    continue;
+	}
+
+	for (auto & metric : hist_metrics) {
+	    vector <double> vals;
+	    vector <long> which;
+
+	    for (auto it = idx.begin(); it != idx.end(); ++it) {
+		double val = records[*it].get(metric.key);
+
+		// no rss from in-process runs
+		if (string(metric.key) == "maxrss_kb" && val <= 0.0) {
+		    continue;
+		}
+		vals.push_back(val);
+		which.push_back(*it);
+	    }
+
+	    vector <ChangePoint> changes;
+	    findChanges(vals, 0, vals.size(), metric, changes);
+
+	    std::sort(changes.begin(), changes.end(),
+		      [](const ChangePoint & a, const ChangePoint & b) { return a.index < b.index; });
+
+	    for (auto cit = changes.begin(); cit != changes.end(); ++cit) {
+		const HistRecord & rec = records[which[cit->index]];
+		const HistRecord & prev = records[which[cit->index - 1]];
+		bool regress = (cit->after - cit->before) * metric.worse > 0;
+		time_t when = rec.time;
+		char date[100];
+
+		strftime(date, sizeof(date), "%Y-%m-%d %H:%M", localtime(&when));
+
+		printf("\n%s: %s  %+.1f%%  (%.2f -> %.2f %s, t = %.1f)\n"
+		       "  file: %s  host: %s  -j %s  -J %s\n"
+		       "  options: %s\n"
+		       "  at: %s  build: %s  (before: %s)\n"
+		       "  dyninst: %s\n",
+		       regress ? "regression" : "improvement", metric.key,
+		       (cit->before != 0.0) ? 100.0 * (cit->after - cit->before) / cit->before : 0.0,
+		       cit->before, cit->after, metric.units, cit->tstat,
+		       rec.str("file").c_str(), rec.str("host").c_str(), rec.str("jobs").c_str(),
+		       rec.str("check_jobs").c_str(), rec.str("options").c_str(),
+		       date, rec.str("build").c_str(),
+		       prev.str("build").c_str(), rec.str("dyninst").c_str());
+
+		if (regress) {
+		    num_regress++;
+		}
+		else {
+		    num_improve++;
+		}
+	    }
+	}
+    }
+
+    printf("\nregressions: %ld  improvements: %ld  (series with under %d runs: %ld)\n\n",
+	   num_regress, num_improve, 2 * HIST_MIN_SEG, num_short);
+
+    return (num_regress > 0) ? 2 : 0;
+}
@@ -10,6 +10,13 @@
 #  Set SPACK, DYNINST, BOOST, etc and run:
 #   ./mk-test.sh  [ file.cpp ]
 #
+#  or, for the checker library (libunknown-x86.so, see unknown-x86.h):
+#   ./mk-test.sh  --lib
+#
+#  or, to build and run the library smoke test (checker-test.cpp) on
+#  a binary (default, the test itself):
+#   ./mk-test.sh  --test  [ binary ]
+#
 
 CXX=g++
 CXXFLAGS='-g -O -std=c++11 -fopenmp'
@@ -22,33 +29,64 @@ ELF=${SPACK}/
 TBB=${SPACK}/
 XED=${SPACK}/
 
+# the checker core (the library) and the program's modes
+core=checker.cpp
+modes='encodings.cpp history.cpp builds.cpp corpus.cpp queue.cpp'
+
 prog=unknown-x86.cpp
+srcs=
+bin=
+mode=prog
 
 #------------------------------------------------------------
 
 die() {
     echo "error: $@"
-    echo "usage: ./mk-test.sh [ file.cpp ]"
+    echo "usage: ./mk-test.sh [ file.cpp | --lib | --test [ binary ] ]"
     exit 1
 }
 
-if test "x$1" != x ; then
-    prog="$1"
-fi
+case "x$1" in
+    x--lib )
+	mode=lib
+	prog=unknown-x86.cpp
+	srcs="$core"
+	;;
+    x--test )
+	mode=test
+	prog=checker-test.cpp
+	srcs="$prog $core"
+	bin="$2"
+	;;
+    x )
+	srcs="$prog $core $modes"
+	;;
+    * )
+	prog="$1"
+	srcs="$prog"
+	;;
+esac
 
 test "x$prog" != x || die "missing file name"
-test -f "$prog" || die "missing input file: $prog"
+for f in $srcs ; do
+    test -f "$f" || die "missing input file: $f"
+done
 
 case "$prog" in
     *?.?* ) out="${prog%.*}" ;;
     * ) die "missing file name extension" ;;
 esac
 
+if test "$mode" = lib ; then
+    CXXFLAGS="$CXXFLAGS -fPIC -shared"
+    out="lib${out}.so"
+fi
+
 #------------------------------------------------------------
 
 set --  \
     $CXXFLAGS  \
-    $prog    \
+    $srcs    \
     -o $out  \
     -I${DYNINST}/include  \
     -I${BOOST}/include    \
@@ -58,9 +96,11 @@ set --  \
     -L${DYNINST}/lib  \
     -lparseAPI  -linstructionAPI  -lsymtabAPI  \
     -ldynDwarf  -ldynElf  -lcommon  \
-    -L${XED}/lib  -lxed  \
+    -L${XED}/lib  -lxed  -lz  \
+    -L${TBB}/lib  -ltbb  \
     -Wl,-rpath=${DYNINST}/lib  \
-    -Wl,-rpath=${XED}/lib
+    -Wl,-rpath=${XED}/lib  \
+    -Wl,-rpath=${TBB}/lib
 
 echo
 echo $CXX $@
@@ -70,3 +110,13 @@ $CXX "$@"
 
 test $? -eq 0 || die "compile failed"
 
+#------------------------------------------------------------
+
+if test "$mode" = test ; then
+    test "x$bin" != x || bin="$out"
+    echo
+    echo ./$out $bin
+    echo
+    ./$out "$bin"
+    test $? -eq 0 || die "smoke test failed"
+fi
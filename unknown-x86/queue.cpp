@@ -0,0 +1,453 @@
+//
+//  Copyright (c) 2023, Rice University
+//  All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//  
+//  1. Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//  
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//  
+//  3. Neither the name of the copyright holder nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------
+//
+//  Multi-node corpus sharding (--queue, --queue-merge).
+//
+// ----------------------------------------------------------------------
+
+#include "unknown-x86-internal.h"
+
+//----------------------------------------------------------------------
+
+// Multi-node corpus sharding:  --queue dir  --corpus dir-or-list
+//
+// Several independent invocations (on one node or many) share a work
+// queue directory on a shared filesystem.  There is no server, all
+// coordination is by atomic rename().
+//
+//   dir/options        options key, all workers must match
+//   dir/todo/NNN       one task file per corpus file (contains path)
+//   dir/claimed/NNN    a worker claims a task by rename from todo
+//   dir/leases/NNN     owner (host, pid), the mtime is a heartbeat
+//   dir/results/NNN    key=value results, written by tmp and rename
+//   dir/done/NNN       finished tasks
+//
+// The first worker to mkdir dir/setup builds dir/todo.tmp and renames
+// it to dir/todo, the others wait for it.  While its children run,
+// the worker touches the leases of its tasks (from the main thread,
+// so there is no other thread at fork time), and when there is
+// nothing left to claim, it moves tasks with expired leases (a crashed
+// worker) back to todo.  Then --queue-merge dir prints the totals.
+//
+// All the times are the file server's:  utimes() with NULL sets the
+// server's time, and expiry compares against the mtime of a freshly
+// touched probe file, so clock skew between nodes doesn't matter.
+//
+#define QUEUE_POLL_SECS  5
+#define QUEUE_WAIT_USECS  100000
+
+static void
+touchLeases(const set <string> & leases)
+{
+    for (auto it = leases.begin(); it != leases.end(); ++it) {
+	utimes(it->c_str(), NULL);
+    }
+}
+
+// The file server's current time, from the mtime of a probe file in
+// dir/leases, or the local time if that fails.
+static time_t
+serverTime(const string & qdir)
+{
+    char host[256];
+    struct stat sb;
+    time_t now = time(NULL);
+
+    if (gethostname(host, sizeof(host)) != 0) {
+	strcpy(host, "unknown");
+    }
+    host[sizeof(host) - 1] = 0;
+
+    string probe = qdir + "/leases/.probe." + host + "." + to_string(getpid());
+    int fd = open(probe.c_str(), O_WRONLY | O_CREAT, 0644);
+
+    if (fd >= 0) {
+	close(fd);
+	if (utimes(probe.c_str(), NULL) == 0 && stat(probe.c_str(), &sb) == 0) {
+	    now = sb.st_mtime;
+	}
+	unlink(probe.c_str());
+    }
+    return now;
+}
+
+static void
+listDir(const string & dirname, vector <string> & names)
+{
+    DIR * dir = opendir(dirname.c_str());
+    struct dirent * ent;
+
+    names.clear();
+    if (dir == NULL) {
+	return;
+    }
+    while ((ent = readdir(dir)) != NULL) {
+	if (ent->d_name[0] != '.') {
+	    names.push_back(ent->d_name);
+	}
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+}
+
+static string
+readSmallFile(const string & path)
+{
+    FILE * fp = fopen(path.c_str(), "r");
+    char buf[4096];
+    string str;
+    size_t len;
+
+    if (fp == NULL) {
+	return str;
+    }
+    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+	str.append(buf, len);
+    }
+    fclose(fp);
+    while (! str.empty() && str.back() == '\n') {
+	str.pop_back();
+    }
+    return str;
+}
+
+// Write a file by tmp and rename, so readers never see a partial file.
+static bool
+writeFileAtomic(const string & path, const string & contents)
+{
+    string tmp = path + ".tmp." + to_string(getpid());
+    FILE * fp = fopen(tmp.c_str(), "w");
+
+    if (fp == NULL) {
+	return false;
+    }
+    fputs(contents.c_str(), fp);
+    fflush(fp);
+    fsync(fileno(fp));
+    if (fclose(fp) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+	unlink(tmp.c_str());
+	return false;
+    }
+    return true;
+}
+
+// Create the queue if we are first, else wait for it.
+static void
+initQueue(const string & qdir)
+{
+    string key = optionsKey();
+
+    mkdir(qdir.c_str(), 0755);
+
+    if (mkdir((qdir + "/setup").c_str(), 0755) == 0) {
+	vector <string> paths;
+	string tmp = qdir + "/todo.tmp";
+	char name[50];
+
+	getCorpusFiles(opts.filename, paths);
+
+	const char * subdirs[] = { "todo.tmp", "claimed", "leases", "results", "done" };
+	for (int k = 0; k < 5; k++) {
+	    if (mkdir((qdir + "/" + subdirs[k]).c_str(), 0755) != 0 && errno != EEXIST) {
+		err(1, "unable to create queue dir: %s/%s", qdir.c_str(), subdirs[k]);
+	    }
+	}
+	for (long n = 0; n < (long) paths.size(); n++) {
+	    snprintf(name, sizeof(name), "/%08ld", n);
+	    if (! writeFileAtomic(tmp + name, paths[n] + "\n")) {
+		err(1, "unable to write task file: %s%s", tmp.c_str(), name);
+	    }
+	}
+	writeFileAtomic(qdir + "/options", key + "\n");
+
+	if (rename(tmp.c_str(), (qdir + "/todo").c_str()) != 0) {
+	    err(1, "unable to rename queue dir: %s", tmp.c_str());
+	}
+	cout << "\nqueue: created " << paths.size() << " tasks in " << qdir << endl;
+    }
+    else {
+	struct stat sb;
+	long waited = 0;
+
+	while (stat((qdir + "/todo").c_str(), &sb) != 0) {
+	    if (waited >= 600) {
+		errx(1, "timeout waiting for queue setup: %s", qdir.c_str());
+	    }
+	    sleep(1);
+	    waited++;
+	}
+    }
+
+    string qkey = readSmallFile(qdir + "/options");
+    if (qkey != key) {
+	errx(1, "options (%s) do not match queue options (%s)", key.c_str(), qkey.c_str());
+    }
+}
+
+// Claim one task by rename from todo to claimed.  Start at a random
+// position so that workers don't all fight over the same file.
+static bool
+claimTask(const string & qdir, string & task, string & path)
+{
+    vector <string> names;
+    char host[256];
+
+    listDir(qdir + "/todo", names);
+    if (names.empty()) {
+	return false;
+    }
+    if (gethostname(host, sizeof(host)) != 0) {
+	strcpy(host, "unknown");
+    }
+    host[sizeof(host) - 1] = 0;
+
+    long num = names.size();
+    long first = hashBytes(host, strlen(host), getpid()) % num;
+
+    for (long k = 0; k < num; k++) {
+	string name = names[(first + k) % num];
+	string todo = qdir + "/todo/" + name;
+	string claimed = qdir + "/claimed/" + name;
+
+	// touch before the rename, rename keeps the mtime, so the
+	// claimed task never looks expired to another worker
+	if (utimes(todo.c_str(), NULL) != 0) {
+	    continue;
+	}
+	if (rename(todo.c_str(), claimed.c_str()) == 0) {
+	    string lease = qdir + "/leases/" + name;
+
+	    writeFileAtomic(lease, string(host) + " " + to_string(getpid()) + "\n");
+
+	    task = name;
+	    path = readSmallFile(claimed);
+	    return true;
+	}
+    }
+    return false;
+}
+
+// Move claimed tasks with expired leases back to todo.  If there is no
+// lease file, use the claimed file's mtime.  Return the number moved.
+static long
+reclaimExpired(const string & qdir)
+{
+    vector <string> names;
+    time_t now = serverTime(qdir);
+    long num = 0;
+
+    listDir(qdir + "/claimed", names);
+
+    for (auto it = names.begin(); it != names.end(); ++it) {
+	string lease = qdir + "/leases/" + *it;
+	string claimed = qdir + "/claimed/" + *it;
+	struct stat sb;
+
+	if (stat(lease.c_str(), &sb) != 0 && stat(claimed.c_str(), &sb) != 0) {
+	    continue;
+	}
+	if (now - sb.st_mtime <= opts.lease_secs) {
+	    continue;
+	}
+	string owner = readSmallFile(lease);
+	unlink(lease.c_str());
+
+	if (rename(claimed.c_str(), (qdir + "/todo/" + *it).c_str()) == 0) {
+	    cout << "queue: reclaimed expired task " << *it
+		 << " (" << (owner.empty() ? "no lease" : owner) << ")" << endl;
+	    num++;
+	}
+    }
+    return num;
+}
+
+// Write the results for one task, then move it to done.
+static void
+finishTask(const string & qdir, const string & task, CorpusFile & cf)
+{
+    string contents;
+    char host[256];
+
+    if (gethostname(host, sizeof(host)) != 0) {
+	strcpy(host, "unknown");
+    }
+    host[sizeof(host) - 1] = 0;
+
+    contents += "path=" + cf.path + "\n";
+    contents += "status=" + to_string(cf.status) + "\n";
+    contents += "host=" + string(host) + "\n";
+    for (auto it = cf.result.begin(); it != cf.result.end(); ++it) {
+	if (it->first != "file") {
+	    contents += it->first + "=" + it->second + "\n";
+	}
+    }
+    if (! writeFileAtomic(qdir + "/results/" + task, contents)) {
+	warn("unable to write results for task %s", task.c_str());
+	return;
+    }
+    rename((qdir + "/claimed/" + task).c_str(), (qdir + "/done/" + task).c_str());
+    unlink((qdir + "/leases/" + task).c_str());
+}
+
+int
+runQueue()
+{
+    string qdir(opts.queue);
+
+    initQueue(qdir);
+
+    map <pid_t, CorpusFile> running;
+    map <pid_t, string> tasks;
+    map <pid_t, string> kv_files;
+    map <pid_t, double> start_time;
+    long num_done = 0;
+    set <string> leases;
+    double lease_period = std::max(1L, opts.lease_secs / 4);
+    double last_touch = omp_get_wtime();
+
+    for (;;) {
+	string task, path;
+
+	while ((long) running.size() < opts.corpus_jobs && claimTask(qdir, task, path)) {
+	    string kv_path;
+	    pid_t pid = startCorpusChild(path, "", kv_path);
+
+	    running[pid].path = path;
+	    tasks[pid] = task;
+	    kv_files[pid] = kv_path;
+	    start_time[pid] = omp_get_wtime();
+
+	    leases.insert(qdir + "/leases/" + task);
+	    leases.insert(qdir + "/claimed/" + task);
+	}
+
+	if (running.empty()) {
+	    vector <string> names;
+
+	    if (reclaimExpired(qdir) > 0) {
+		continue;
+	    }
+	    listDir(qdir + "/claimed", names);
+	    if (names.empty()) {
+		break;
+	    }
+	    // other workers still running, wait in case they crash
+	    sleep(QUEUE_POLL_SECS);
+	    continue;
+	}
+
+	// wait for a child, touching the leases every lease/4 secs
+	int status = 0;
+	pid_t pid;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) == 0) {
+	    if (omp_get_wtime() - last_touch >= lease_period) {
+		touchLeases(leases);
+		last_touch = omp_get_wtime();
+	    }
+	    usleep(QUEUE_WAIT_USECS);
+	}
+	if (pid < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    err(1, "waitpid failed");
+	}
+	if (running.find(pid) == running.end()) {
+	    continue;
+	}
+
+	CorpusFile & cf = running[pid];
+	cf.status = status;
+	cf.secs = omp_get_wtime() - start_time[pid];
+	readKeyValues(kv_files[pid].c_str(), cf.result);
+	cf.result["wall_secs"] = to_string(cf.secs);
+	unlink(kv_files[pid].c_str());
+
+	leases.erase(qdir + "/leases/" + tasks[pid]);
+	leases.erase(qdir + "/claimed/" + tasks[pid]);
+
+	finishTask(qdir, tasks[pid], cf);
+	num_done++;
+	printCorpusLine(cf, num_done, 0);
+
+	running.erase(pid);
+	tasks.erase(pid);
+	kv_files.erase(pid);
+	start_time.erase(pid);
+    }
+
+    cout << "\nqueue: this worker finished " << num_done << " files, queue is empty\n"
+	 << "use --queue-merge " << qdir << " for the totals\n" << endl;
+
+    return 0;
+}
+
+// Final aggregate step:  --queue-merge dir
+int
+mergeQueue()
+{
+    string qdir(opts.filename);
+    vector <string> names;
+    vector <string> todo;
+    vector <CorpusFile> files;
+
+    listDir(qdir + "/results", names);
+
+    for (auto it = names.begin(); it != names.end(); ++it) {
+	if (it->find(".tmp.") != string::npos) {
+	    continue;
+	}
+	CorpusFile cf;
+
+	readKeyValues((qdir + "/results/" + *it).c_str(), cf.result);
+	cf.path = cf.result["path"];
+	cf.status = atoi(cf.result["status"].c_str());
+	cf.secs = atof(cf.result["wall_secs"].c_str());
+	files.push_back(cf);
+    }
+
+    cout << endl;
+    for (long n = 0; n < (long) files.size(); n++) {
+	printCorpusLine(files[n], n + 1, files.size());
+    }
+
+    listDir(qdir + "/todo", todo);
+    listDir(qdir + "/claimed", names);
+    if (! todo.empty() || ! names.empty()) {
+	printf("\nwarning: queue is not finished, todo: %ld  claimed: %ld\n",
+	       (long) todo.size(), (long) names.size());
+    }
+
+    printCorpusSummary(files);
+
+    return 0;
+}
@@ -0,0 +1,733 @@
+//
+//  Copyright (c) 2023, Rice University
+//  All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//  
+//  1. Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//  
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//  
+//  3. Neither the name of the copyright holder nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------
+//
+//  Internal declarations shared by the unknown-x86 source files:
+//  the checker core (checker.cpp, which is also the library), the
+//  program (unknown-x86.cpp) and its modes (encodings.cpp,
+//  history.cpp, builds.cpp, corpus.cpp and queue.cpp).
+//
+// ----------------------------------------------------------------------
+
+#ifndef UNKNOWN_X86_INTERNAL_H
+#define UNKNOWN_X86_INTERNAL_H
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <elf.h>
+#include <err.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <math.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include <zlib.h>
+
+#include <tbb/global_control.h>
+#include <tbb/task_arena.h>
+
+#include <CFG.h>
+#include <CodeObject.h>
+#include <CodeSource.h>
+#include <Function.h>
+#include <LineInformation.h>
+#include <Module.h>
+#include <Symtab.h>
+#include <BinaryFunction.h>
+#include <Dereference.h>
+#include <Immediate.h>
+#include <Instruction.h>
+#include <InstructionDecoder.h>
+#include <Register.h>
+
+extern "C" {
+#include <xed-interface.h>
+}
+
+#include "unknown-x86.h"
+#include "verdict-table.h"
+
+// USDT probes (provider unknown_x86) for bpftrace and systemtap.  With
+// <sys/sdt.h> (systemtap-sdt-devel), each probe is a nop plus an ELF
+// note, so they can stay in release builds and cost nothing until
+// attached.  Without it, they compile to nothing.
+//
+//   phase-start (phase, file), phase-end (phase, file, usecs)
+//     phase is "read", "parse", "check" or "gaps"
+//   callback-entry (buf, len), callback-exit (buf, outcome, xed_len)
+//     outcome is 1 for valid, 2 for troll, 0 for error
+//   function-start (addr), function-end (addr, problems)
+//   finding (kind, addr, size)
+//     kind is KIND_BAD_LENGTH, KIND_BLOCK, KIND_GAP or KIND_OVERLAP
+//
+//   bpftrace -e 'usdt:./unknown-x86:unknown_x86:finding { @[arg0] = count(); }'
+//
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define UX_HAVE_SDT  1
+#endif
+#endif
+
+#ifdef UX_HAVE_SDT
+#define PROBE1(name, a)  DTRACE_PROBE1(unknown_x86, name, a)
+#define PROBE2(name, a, b)  DTRACE_PROBE2(unknown_x86, name, a, b)
+#define PROBE3(name, a, b, c)  DTRACE_PROBE3(unknown_x86, name, a, b, c)
+#else
+// sizeof uses the args (no unused warnings) without evaluating them
+#define PROBE1(name, a)  do { (void) sizeof(a); } while (0)
+#define PROBE2(name, a, b)  do { (void) sizeof(a); (void) sizeof(b); } while (0)
+#define PROBE3(name, a, b, c)  \
+    do { (void) sizeof(a); (void) sizeof(b); (void) sizeof(c); } while (0)
+#endif
+
+#define PROBE_USECS(start)  ((long) ((omp_get_wtime() - (start)) * 1000000.0))
+
+using namespace Dyninst;
+using namespace ParseAPI;
+using namespace SymtabAPI;
+using namespace InstructionAPI;
+using namespace std;
+using namespace CheckerKind;
+
+//----------------------------------------------------------------------
+
+// Summary stats
+
+// One finding, for source attribution (--source), weighting by
+// samples (--profile) or function verdicts (--verdicts).  Size is
+// only used for gaps.
+class Finding {
+public:
+    Address  addr;
+    int   kind;
+    long  size;
+
+    Finding(Address a, int k, long sz = 0) : addr(a), kind(k), size(sz) { }
+};
+
+// One instruction boundary from phase 2, for --objdump and
+// --boundaries.
+class InsnBound {
+public:
+    Address  addr;
+    uint8_t  dyn_len;
+    uint8_t  xed_len;
+
+    InsnBound(Address a, int dl, int xl) : addr(a), dyn_len(dl), xed_len(xl) { }
+
+    bool operator < (const InsnBound & other) const {
+	return addr < other.addr;
+    }
+};
+
+// Phase 2 stats are kept per thread and summed at the end.
+class CheckStats {
+public:
+    long  num_blocks;
+    long  num_instns;
+    long  num_bytes;
+    long  num_bad_length;
+    long  num_block_align_errors;
+    long  num_block_length_errors;
+    long  num_cache_hits;
+    long  num_desync;
+    unordered_set <string> new_verdicts;
+    vector <Finding> findings;
+    vector <InsnBound> bounds;
+
+    CheckStats() {
+	num_blocks = 0;
+	num_instns = 0;
+	num_bytes = 0;
+	num_bad_length = 0;
+	num_block_align_errors = 0;
+	num_block_length_errors = 0;
+	num_cache_hits = 0;
+	num_desync = 0;
+    }
+
+    void add(const CheckStats & other) {
+	num_blocks += other.num_blocks;
+	num_instns += other.num_instns;
+	num_bytes += other.num_bytes;
+	num_bad_length += other.num_bad_length;
+	num_block_align_errors += other.num_block_align_errors;
+	num_block_length_errors += other.num_block_length_errors;
+	num_cache_hits += other.num_cache_hits;
+	num_desync += other.num_desync;
+	new_verdicts.insert(other.new_verdicts.begin(), other.new_verdicts.end());
+	findings.insert(findings.end(), other.findings.begin(), other.findings.end());
+	bounds.insert(bounds.end(), other.bounds.begin(), other.bounds.end());
+    }
+};
+
+// Per numa node throughput for phase 2, only with --numa.
+class NodeStats {
+public:
+    long  threads;
+    long  cfg_funcs;
+    long  local_funcs;
+    long  remote_funcs;
+    long  num_instns;
+    double  thread_secs;
+
+    NodeStats() {
+	threads = 0;
+	cfg_funcs = 0;
+	local_funcs = 0;
+	remote_funcs = 0;
+	num_instns = 0;
+	thread_secs = 0.0;
+    }
+};
+
+// One thread's reservoir sample of the records past max_print (see
+// Output records and volume control).
+class RecordSampler {
+public:
+    long  seen[NUM_KINDS];
+    vector <string> sample[NUM_KINDS];
+    mt19937_64  rng;
+
+    RecordSampler(long seed) : rng(seed) {
+	for (int k = 0; k < NUM_KINDS; k++) {
+	    seen[k] = 0;
+	}
+    }
+};
+
+// Sorted, non-overlapping [lo, hi) ranges (--offsets, .eh_frame).
+typedef vector <pair <Address, Address>> RangeList;
+
+// True if addr is inside one of the ranges.
+bool inRanges(const RangeList & ranges, Address addr);
+
+// One block in the block index (see Findings by function).
+class BlockRange {
+public:
+    Address  start;
+    Address  end;
+    ParseAPI::Function *  func;
+
+    bool operator < (const BlockRange & other) const {
+	return start < other.start;
+    }
+};
+
+// Everything about the analysis of one file:  the input, the Symtab,
+// the phase counters and the findings.  The thread counts and fix
+// options are copied from opts, so the library can set them per call,
+// the other options are the same for every file and stay in opts.
+//
+// The current analysis is ctx, a thread-local pointer, so several
+// files can be analyzed at once in one process (--in-process).  The
+// thread that runs analyzeFile() sets it, and so do the phase 2
+// threads and the openmp threads that run parse().  The unknown
+// instruction callback is one global registration, so it dispatches
+// through ctx, checked against the analysis's code buffers (see
+// findAnalysis()).
+//
+class Analysis {
+public:
+    // input, mem_image is an in-memory ELF image (--archive)
+    const char * filename;
+    const char * offsets;
+    const char * kv_out;
+    char * mem_image;
+    size_t  mem_image_size;
+
+    // per analysis options
+    int   jobs;
+    int   check_jobs;
+    bool  fix_valid;
+    bool  fix_troll;
+
+    Symtab * symtab;
+    vector <pair <const unsigned char *, const unsigned char *>> code_ptrs;
+    vector <Address> code_addrs;
+
+    // phase 1, the counters are protected by lock
+    mutex  lock;
+    int   initial_parse;
+    long  num_unknown;
+    long  num_unknown_valid;
+    long  num_unknown_troll;
+    long  num_unknown_error;
+    atomic <long> num_fix_branch;
+
+    // Consecutive XED errors in the unknown callback, to stop a run
+    // of fixed trolls.
+    atomic <int> num_xed_errors;
+
+    // Output records per kind and the per-thread reservoirs.  id
+    // tells a thread's cached sampler (my_sampler) which analysis it
+    // belongs to, since an Analysis can reuse a freed address.
+    long  id;
+    atomic <long> kind_count[NUM_KINDS];
+    mutex  sampler_lock;
+    vector <RecordSampler *> samplers;
+
+    // Confirmed problems (unknown valid or troll, bad length, block
+    // errors) for --fail-fast, and the buffer pointers from the
+    // unknown callback, to find which functions hit it.
+    atomic <long> num_problems;
+    atomic <bool> fail_fast_stop;
+    vector <const unsigned char *> unknown_ptrs;
+
+    // An error that ends the analysis (see analysisError()), the
+    // message is protected by lock.
+    atomic <bool> failed;
+    string  error;
+
+    // phase 2
+    CheckStats  check_stats;
+    vector <NodeStats> node_stats;
+
+    // phase 3
+    long  num_gaps;
+    long  num_gaps_16;
+    long  num_gaps_64;
+    long  num_gaps_256;
+    long  num_gaps_other;
+    long  num_overlap;
+    long  size_gaps;
+    long  size_gaps_16;
+    long  size_gaps_64;
+    long  size_gaps_256;
+    long  size_gaps_other;
+
+    double  parse_secs;
+    double  check_secs;
+    double  gaps_secs;
+    unordered_map <ParseAPI::Function *, vector <ParseAPI::Function *>> clone_groups;
+    long  num_clone_groups;
+    long  num_clones;
+    long  clone_bytes;
+    double  clone_secs;
+    double  parse_cpu;
+    double  check_cpu;
+    double  gaps_cpu;
+    long  max_threads;
+    long  code_bytes;
+    long  covered_bytes;
+
+    // Gap and overlap findings from phase 3, for --source, --profile
+    // and --verdicts.
+    vector <Finding> gap_findings;
+    bool  want_findings;
+    bool  want_bounds;
+
+    // --offsets, --profile, --objdump, --boundaries and --eh-frame
+    vector <BlockRange> block_index;
+    RangeList  mapped_ranges;
+    vector <pair <Address, long>> profile_samples;
+    unordered_map <ParseAPI::Function *, long> func_samples;
+    long  profile_total;
+    long  profile_mapped;
+
+    long  objdump_num_insns;
+    long  objdump_matched;
+    long  objdump_agree;
+    long  objdump_dyn_wrong;
+    long  objdump_xed_wrong;
+    long  objdump_differs;
+    long  objdump_all_differ;
+    long  objdump_missing;
+    long  objdump_bytes;
+    double  objdump_secs;
+
+    long  bound_num_lines;
+    long  bound_lines_checked;
+    long  bound_lines_bad;
+    long  bound_num_relocs;
+    long  bound_relocs_checked;
+    long  bound_relocs_bad;
+
+    RangeList  fde_ranges;
+    long  num_fde_seeded;
+    long  fde_bytes;
+    long  fde_covered;
+    long  num_fde_missed;
+    double  eh_secs;
+
+    Analysis(const char * name);
+
+    ~Analysis() {
+	for (auto it = samplers.begin(); it != samplers.end(); ++it) {
+	    delete *it;
+	}
+    }
+
+    // true if ptr is inside one of the code buffers
+    bool hasCode(const unsigned char * ptr) {
+	for (auto it = code_ptrs.begin(); it != code_ptrs.end(); ++it) {
+	    if (ptr >= it->first && ptr < it->second) {
+		return true;
+	    }
+	}
+	return false;
+    }
+
+    // the address of ptr in the code buffers, or 0 if not in one
+    Address codeAddr(const unsigned char * ptr) {
+	for (long n = 0; n < (long) code_ptrs.size(); n++) {
+	    if (ptr >= code_ptrs[n].first && ptr < code_ptrs[n].second) {
+		return code_addrs[n] + (ptr - code_ptrs[n].first);
+	    }
+	}
+	return 0;
+    }
+};
+
+extern thread_local Analysis * ctx;
+
+//----------------------------------------------------------------------
+
+// Sort Functions and Blocks by address, low to high.
+bool FuncLessThan(ParseAPI::Function * f1, ParseAPI::Function * f2);
+bool BlockLessThan(Block * b1, Block * b2);
+bool FindingLessThan(const Finding & f1, const Finding & f2);
+
+//----------------------------------------------------------------------
+
+// Kinds of output records (KIND_* in unknown-x86.h)
+extern const char * kind_name[NUM_KINDS];
+
+#define NUMA_NONE     0
+#define NUMA_SPREAD   1
+#define NUMA_COMPACT  2
+
+#define INPUT_ELF      0
+#define INPUT_JITDUMP  1
+#define INPUT_BLOB     2
+
+// Command-line options
+class Options {
+public:
+    const char *filename;
+    const char *numa_nodes;
+    const char *diff_old;
+    const char *builds;
+    const char *kv_out;
+    const char *xed_cache;
+    const char *checkpoint;
+    const char *queue;
+    const char *offsets;
+    const char *profile;
+    const char *verdicts;
+    const char *objdump;
+    const char *jobs_profile;
+    const char *history;
+    int   file_index;
+    int   corpus_jobs;
+    bool  corpus;
+    bool  maps;
+    bool  archive;
+    bool  in_process;
+    bool  resume;
+    bool  queue_merge;
+    bool  history_report;
+    long  lease_secs;
+    int   jobs;
+    int   check_jobs;
+    bool  jobs_auto;
+    bool  check_jobs_set;
+    int   numa;
+    int   input;
+    long  max_print[NUM_KINDS];
+    long  sample;
+    long  fail_fast;
+    double  hot_pct;
+    bool  quiet;
+    bool  verbose;
+    bool  fix_valid;
+    bool  fix_troll;
+    bool  order_score;
+    bool  source;
+    bool  eh_frame;
+    bool  boundaries;
+    bool  clones;
+
+    Options() {
+	filename = NULL;
+	numa_nodes = NULL;
+	diff_old = NULL;
+	builds = NULL;
+	kv_out = NULL;
+	xed_cache = NULL;
+	checkpoint = NULL;
+	queue = NULL;
+	offsets = NULL;
+	profile = NULL;
+	verdicts = NULL;
+	objdump = NULL;
+	jobs_profile = NULL;
+	history = NULL;
+	history_report = false;
+	queue_merge = false;
+	lease_secs = 600;
+	corpus = false;
+	maps = false;
+	archive = false;
+	in_process = false;
+	resume = false;
+	corpus_jobs = 1;
+	file_index = 0;
+	jobs = 1;
+	check_jobs = 1;
+	jobs_auto = false;
+	check_jobs_set = false;
+	numa = NUMA_NONE;
+	input = INPUT_ELF;
+	sample = 0;
+	fail_fast = 0;
+	hot_pct = 100.0;
+	order_score = false;
+	source = false;
+	eh_frame = false;
+	boundaries = false;
+	clones = false;
+	for (int k = 0; k < NUM_KINDS; k++) {
+	    max_print[k] = -1;
+	}
+	quiet = false;
+	verbose = false;
+	fix_valid = false;
+	fix_troll = false;
+    }
+};
+
+extern Options opts;
+
+//----------------------------------------------------------------------
+
+// NUMA nodes (see getNumaTopology()).
+class NumaNode {
+public:
+    int  node;
+    vector <int> cpus;
+};
+
+//----------------------------------------------------------------------
+
+// One file in corpus mode and its results (key=value lines).
+class CorpusFile {
+public:
+    string  path;
+    string  ranges;
+    uint64_t  hash;
+    int   status;
+    bool  resumed;
+    double  secs;
+    map <string, string> result;
+
+    CorpusFile() {
+	hash = 0;
+	status = 0;
+	resumed = false;
+	secs = 0.0;
+    }
+};
+
+//----------------------------------------------------------------------
+
+// Findings by function (see buildBlockIndex()).
+//
+// Merge a sorted list of addresses against the block index, calling
+// fn(func, n) for each address n and each function with a block that
+// contains it.  A block shared by several functions is in the index
+// once per function, so every owner gets the call.
+//
+// Dyninst ends the block at an unknown instruction, so an address
+// with at_end(n) true belongs to the block that ends there:  those
+// match the last blocks starting before the address, end inclusive.
+template <typename AtEnd, typename Fn>
+void
+mergeBlockIndex(const vector <Address> & addrs, AtEnd at_end, Fn fn)
+{
+    const vector <BlockRange> & index = ctx->block_index;
+    long j = 0;
+
+    for (long n = 0; n < (long) addrs.size(); n++) {
+	Address addr = addrs[n];
+	bool end_ok = at_end(n);
+
+	while (j < (long) index.size() && index[j].start <= addr) {
+	    j++;
+	}
+
+	// the blocks starting at the same address (shared blocks)
+	long k = j;
+	if (end_ok) {
+	    while (k > 0 && index[k - 1].start == addr) {
+		k--;
+	    }
+	}
+	if (k == 0) {
+	    continue;
+	}
+	Address start = index[k - 1].start;
+
+	for (long i = k - 1; i >= 0 && index[i].start == start; i--) {
+	    if (addr < index[i].end || (end_ok && addr == index[i].end)) {
+		fn(index[i].func, n);
+	    }
+	}
+    }
+}
+
+template <typename Fn>
+void
+mergeBlockIndex(const vector <Address> & addrs, Fn fn)
+{
+    mergeBlockIndex(addrs, [](long) { return false; }, fn);
+}
+
+//----------------------------------------------------------------------
+
+// checker.cpp -- the checker core and library
+
+extern vector <NumaNode> numa_nodes;
+extern atomic <long> num_stray_callbacks;
+extern unordered_set <string> xed_cache;
+extern long xed_cache_loaded;
+extern mutex xed_pending_mutex;
+extern unordered_set <string> xed_pending;
+
+void getNumaTopology();
+int numaThreadNode(int tid);
+void pinThread(int index);
+void unpinThread();
+double cpuSecs();
+long numThreads();
+double utilization(double cpu, double wall, int threads);
+void bufPrintf(string & buf, const char * fmt, ...);
+void emitRecord(int kind, const string & line, string * out);
+void printSamples(int kind);
+void printRecordCounts();
+void maskDispImm(const xed_decoded_inst_t * xedd, char * bytes, int len, bool rel_only);
+InstructionAPI::Instruction myXedCallback(InstructionDecoder::buffer seqn);
+void loadXedCache(const char * path);
+void saveXedCache(const char * path, const unordered_set <string> & new_verdicts);
+uint64_t hashBytes(const void * data, size_t len, uint64_t seed = 0);
+uint64_t hashFile(const char * path);
+void findClones(const vector <ParseAPI::Function *> & funcVec, CodeSource * code_src,
+		vector <ParseAPI::Function *> & checkVec);
+void checkFunctions(vector <ParseAPI::Function *> & funcVec);
+void checkFunctionsNuma(vector <ParseAPI::Function *> & funcVec);
+void getUnknownAddrs(CodeSource * code_src, vector <Address> & addrs);
+void doGaps(vector <ParseAPI::Function *> & funcVec);
+void buildBlockIndex(vector <ParseAPI::Function *> & funcVec);
+void mergeRanges(RangeList & ranges);
+void parseCode(CodeObject * code_obj);
+void endAnalysis();
+void getSortedFuncs(CodeObject * code_obj, vector <ParseAPI::Function *> & funcVec);
+
+//----------------------------------------------------------------------
+
+// unknown-x86.cpp -- options, per-file analysis and reports
+
+void usage(string mesg);
+void readKeyValues(const char * path, map <string, string> & kv);
+string optionsKey();
+int analyzeFile(Analysis & an);
+
+//----------------------------------------------------------------------
+
+// encodings.cpp -- --diff-encodings
+
+int diffEncodings();
+
+//----------------------------------------------------------------------
+
+// history.cpp -- --history and --history-report
+
+void appendHistory(const char * path, long num_funcs);
+int historyReport(const char * path);
+
+//----------------------------------------------------------------------
+
+// builds.cpp -- --builds
+
+void * prefetchFile(const char * filename, size_t & size);
+int runBuilds(char **argv);
+
+//----------------------------------------------------------------------
+
+// corpus.cpp -- --corpus, --maps and --archive
+
+void getCorpusFiles(const char * arg, vector <string> & paths);
+pid_t startCorpusChild(const string & path, const string & ranges, string & kv_path,
+		       char * image = NULL, size_t image_size = 0);
+void printCorpusLine(const CorpusFile & cf, long num, long total);
+void printCorpusSummary(vector <CorpusFile> & files);
+int runCorpus();
+int runArchive();
+
+//----------------------------------------------------------------------
+
+// queue.cpp -- --queue and --queue-merge
+
+int runQueue();
+int mergeQueue();
+
+#endif
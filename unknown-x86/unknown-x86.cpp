@@ -52,124 +52,84 @@
 //
 //  Usage:
 //    ./unknown-x86  [options]...  filename
+//    ./unknown-x86  [options]...  --input jitdump  jit-pid.dump
+//    ./unknown-x86  [options]...  --input blob  file@base,...
+//    ./unknown-x86  [options]...  --corpus  dir-or-list-file
+//    ./unknown-x86  [options]...  --maps  pid-or-maps-file
+//    ./unknown-x86  [options]...  --archive  pkg.tar[.gz]|pkg.cpio|pkg.rpm|-
+//    ./unknown-x86  --queue-merge  queue-dir
+//    ./unknown-x86  --history-report  history-file
+//    ./unknown-x86  [options]...  --diff-encodings old-file  new-file
 //
 //  Options:
 //    -j num        use num openmp threads for parse phase (default 1)
+//    -J num        use num threads for phase 2 checking (default 1)
+//    -j auto       pick -j and -J from the code size, function symbols,
+//                  cores and memory, and the --jobs-profile timings
+//    --jobs-profile file  append this run's timings to file, the
+//                  model for -j auto
+//    --numa mode   pin threads to numa nodes, mode is spread or compact
+//    --numa-nodes list  restrict --numa to these nodes (eg, 0,1)
 //    -q            turn off all output except for summary
+//    --input fmt   filename format: elf (default), jitdump (perf
+//                  jit-pid.dump file) or blob (raw code, file@base,...)
+//    --order mode  phase 2 function order, addr or score (default addr)
+//    --fail-fast num  stop after num problems, exit status 2
+//    --profile file  sample profile (address count lines), check the
+//                  hot functions first and weight the summary by samples
+//    --hot pct     with --profile, only check the functions covering
+//                  the top pct% of samples
+//    --source      attribute findings to compile unit and file:line
+//    --objdump file  compare lengths with 'objdump -dw' output from
+//                  file (or - for stdin) and report 3-way differences
+//    --boundaries  check that line table rows start and relocations
+//                  are inside dyninst's instructions
+//    --eh-frame    add function entries from the .eh_frame FDEs (for
+//                  stripped binaries) and report FDE coverage
+//    --clones      check one function of each group of clones (same
+//                  code, different address) and copy the results
+//    --max-print spec  print only the first N records of each kind,
+//                  spec is N or kind=N,... (unknown, bad, block, gap, overlap)
+//    --sample num  print a random sample of num more records per kind
 //    --fix         attempt to fix unknown instructions (default no)
 //    --fix-all     attempt to fix all unknown and trolled instructions
 //    --no-fix      do not fix any instructions
+//    --diff-encodings old-file  check only the instruction encodings
+//                  that are in filename but not in old-file, exit
+//                  status 2 if any are unknown or bad length
+//    --builds name=worker,...  run filename with each worker (unknown-x86
+//                  built with another dyninst) and compare the results
+//    --xed-cache file  read and update a cache of XED length verdicts
+//    --kv-out file  write the summary as key=value lines to file
+//    --history file  append this run's timings, peak RSS and counts
+//                  to a performance history file
+//    --history-report  report regressions (change points) in the
+//                  history file, exit status 2 if any
+//    --verdicts file  write a per-function verdict table (see
+//                  verdict-table.h) for instrumenters to mmap
+//    --corpus      analyze every ELF file in a directory (recursive)
+//                  or list file, each file in a separate process
+//    --maps        corpus of the executable files mapped by a process,
+//                  from /proc/pid/maps or a saved copy, by build-id
+//    --archive     corpus of the ELF members of a tar, cpio or rpm
+//                  file (or - for stdin), gzip ok, analyzed in memory
+//    --offsets list  restrict results to these file offset ranges
+//                  (eg, 0x1000-0x5000,...)
+//    --corpus-jobs num  run num files at once in corpus mode (default 1)
+//    --in-process  run the corpus files in threads of one process, not
+//                  forked children (faster for small files, no crash
+//                  isolation)
+//    --checkpoint file  journal each completed corpus file to file
+//    --resume      skip corpus files already done (ok) in the checkpoint file
+//    --queue dir   share corpus files with other workers through a
+//                  work queue directory on a shared filesystem
+//    --lease secs  reclaim queue tasks idle for secs (default 600)
+//    --queue-merge print the totals for a finished queue directory
 //    -h, --help    display usage message and exit
 //
 // ----------------------------------------------------------------------
 
-#include <sys/types.h>
-#include <err.h>
-#include <errno.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <unistd.h>
-
-#include <omp.h>
-
-#include <iostream>
-#include <map>
-#include <string>
-#include <vector>
-#include <mutex>
-
-#include <CFG.h>
-#include <CodeObject.h>
-#include <CodeSource.h>
-#include <Function.h>
-#include <Symtab.h>
-#include <Instruction.h>
-#include <InstructionDecoder.h>
-
-extern "C" {
-#include <xed-interface.h>
-}
-
-using namespace Dyninst;
-using namespace ParseAPI;
-using namespace SymtabAPI;
-using namespace InstructionAPI;
-using namespace std;
-
-Symtab * the_symtab = NULL;
-
-static mutex print_mutex;
-static int initial_parse = 1;
-
-//----------------------------------------------------------------------
-
-// Summary stats
-
-static long num_blocks = 0;
-static long num_instns = 0;
-static long num_bytes = 0;
-
-static long num_unknown = 0;
-static long num_unknown_valid = 0;
-static long num_unknown_troll = 0;
-static long num_unknown_error = 0;
-
-static long num_bad_length = 0;
-static long num_block_align_errors = 0;
-static long num_block_length_errors = 0;
-
-static long num_gaps = 0;
-static long num_gaps_16 = 0;
-static long num_gaps_64 = 0;
-static long num_gaps_256 = 0;
-static long num_gaps_other = 0;
-static long num_overlap = 0;
-
-static long size_gaps = 0;
-static long size_gaps_16 = 0;
-static long size_gaps_64 = 0;
-static long size_gaps_256 = 0;
-static long size_gaps_other = 0;
-
-//----------------------------------------------------------------------
-
-// Sort Functions by entry address, low to high.
-static bool
-FuncLessThan(ParseAPI::Function * f1, ParseAPI::Function * f2)
-{
-    return f1->addr() < f2->addr();
-}
-
-// Sort Blocks by start address, low to high.
-static bool
-BlockLessThan(Block * b1, Block * b2)
-{
-    return b1->start() < b2->start();
-}
-
-//----------------------------------------------------------------------
-
-// Command-line options
-class Options {
-public:
-    const char *filename;
-    int   jobs;
-    bool  quiet;
-    bool  verbose;
-    bool  fix_valid;
-    bool  fix_troll;
-
-    Options() {
-	filename = NULL;
-	jobs = 1;
-	quiet = false;
-	verbose = false;
-	fix_valid = false;
-	fix_troll = false;
-    }
-};
-
-Options opts;
+#include "unknown-x86-internal.h"
 
 //----------------------------------------------------------------------
 
@@ -180,19 +140,129 @@ usage(string mesg)
 	cout << "error: " << mesg << "\n\n";
     }
 
-    cout << "usage:  unknown-x86  [options]...  filename\n\n"
+    cout << "usage:  unknown-x86  [options]...  filename\n"
+	 << "        unknown-x86  [options]...  --input jitdump  jit-pid.dump\n"
+	 << "        unknown-x86  [options]...  --input blob  file@base,...\n"
+	 << "        unknown-x86  [options]...  --corpus  dir-or-list-file\n"
+	 << "        unknown-x86  [options]...  --maps  pid-or-maps-file\n"
+	 << "        unknown-x86  [options]...  --archive  pkg.tar[.gz]|pkg.cpio|pkg.rpm|-\n"
+	 << "        unknown-x86  --queue-merge  queue-dir\n"
+	 << "        unknown-x86  --history-report  history-file\n"
+	 << "        unknown-x86  [options]...  --diff-encodings old-file  new-file\n\n"
 	 << "options:\n"
 	 << "  -j num        use num openmp threads for parse phase (default 1)\n"
+	 << "  -J num        use num threads for phase 2 checking (default 1)\n"
+	 << "  -j auto       pick -j and -J from the code size, function symbols,\n"
+	 << "                cores and memory, and the --jobs-profile timings\n"
+	 << "  --jobs-profile file  append this run's timings to file, the\n"
+	 << "                model for -j auto\n"
+	 << "  --numa mode   pin threads to numa nodes, mode is spread or compact\n"
+	 << "  --numa-nodes list  restrict --numa to these nodes (eg, 0,1)\n"
 	 << "  -q            turn off all output except for summary\n"
+	 << "  --input fmt   filename format: elf (default), jitdump (perf\n"
+	 << "                jit-pid.dump file) or blob (raw code, file@base,...)\n"
+	 << "  --order mode  phase 2 function order, addr or score (default addr)\n"
+	 << "  --fail-fast num  stop after num problems, exit status 2\n"
+	 << "  --profile file  sample profile (address count lines), check the\n"
+	 << "                hot functions first and weight the summary by samples\n"
+	 << "  --hot pct     with --profile, only check the functions covering\n"
+	 << "                the top pct% of samples\n"
+	 << "  --source      attribute findings to compile unit and file:line\n"
+	 << "  --objdump file  compare lengths with 'objdump -dw' output from\n"
+	 << "                file (or - for stdin) and report 3-way differences\n"
+	 << "  --boundaries  check that line table rows start and relocations\n"
+	 << "                are inside dyninst's instructions\n"
+	 << "  --eh-frame    add function entries from the .eh_frame FDEs (for\n"
+	 << "                stripped binaries) and report FDE coverage\n"
+	 << "  --clones      check one function of each group of clones (same\n"
+	 << "                code, different address) and copy the results\n"
+	 << "  --max-print spec  print only the first N records of each kind,\n"
+	 << "                spec is N or kind=N,... (unknown, bad, block, gap, overlap)\n"
+	 << "  --sample num  print a random sample of num more records per kind\n"
 	 << "  --fix         attempt to fix unknown instructions (default no)\n"
 	 << "  --fix-all     attempt to fix all unknown and trolled instructions\n"
 	 << "  --no-fix      do not fix any instructions\n"
+	 << "  --diff-encodings old-file  check only the instruction encodings\n"
+	 << "                that are in filename but not in old-file, exit\n"
+	 << "                status 2 if any are unknown or bad length\n"
+	 << "  --builds name=worker,...  run filename with each worker (unknown-x86\n"
+	 << "                built with another dyninst) and compare the results\n"
+	 << "  --xed-cache file  read and update a cache of XED length verdicts\n"
+	 << "  --kv-out file  write the summary as key=value lines to file\n"
+	 << "  --history file  append this run's timings, peak RSS and counts\n"
+	 << "                to a performance history file\n"
+	 << "  --history-report  report regressions (change points) in the\n"
+	 << "                history file, exit status 2 if any\n"
+	 << "  --verdicts file  write a per-function verdict table (see\n"
+	 << "                verdict-table.h) for instrumenters to mmap\n"
+	 << "  --corpus      analyze every ELF file in a directory (recursive)\n"
+	 << "                or list file, each file in a separate process\n"
+	 << "  --maps        corpus of the executable files mapped by a process,\n"
+	 << "                from /proc/pid/maps or a saved copy, by build-id\n"
+	 << "  --archive     corpus of the ELF members of a tar, cpio or rpm\n"
+	 << "                file (or - for stdin), gzip ok, analyzed in memory\n"
+	 << "  --offsets list  restrict results to these file offset ranges\n"
+	 << "                (eg, 0x1000-0x5000,...)\n"
+	 << "  --corpus-jobs num  run num files at once in corpus mode (default 1)\n"
+	 << "  --in-process  run the corpus files in threads of one process, not\n"
+	 << "                forked children (faster for small files, no crash\n"
+	 << "                isolation)\n"
+	 << "  --checkpoint file  journal each completed corpus file to file\n"
+	 << "  --resume      skip corpus files already done (ok) in the checkpoint file\n"
+	 << "  --queue dir   share corpus files with other workers through a\n"
+	 << "                work queue directory on a shared filesystem\n"
+	 << "  --lease secs  reclaim queue tasks idle for secs (default 600)\n"
+	 << "  --queue-merge print the totals for a finished queue directory\n"
 	 << "  -h, --help    display usage message and exit\n"
 	 << "\n";
 
     exit(1);
 }
 
+// Max print spec:  N (all kinds) or kind=N, comma separated.
+void
+parseMaxPrint(const char * arg, Options & opts)
+{
+    string spec(arg);
+    size_t pos = 0;
+
+    while (pos <= spec.size()) {
+	size_t end = spec.find(',', pos);
+	if (end == string::npos) {
+	    end = spec.size();
+	}
+	string item = spec.substr(pos, end - pos);
+	size_t eq = item.find('=');
+	string num = (eq == string::npos) ? item : item.substr(eq + 1);
+	char * p;
+	long val = strtol(num.c_str(), &p, 10);
+
+	if (num.empty() || *p != 0 || val < 0) {
+	    usage("bad arg for --max-print: " + spec);
+	}
+
+	if (eq == string::npos) {
+	    for (int k = 0; k < NUM_KINDS; k++) {
+		opts.max_print[k] = val;
+	    }
+	}
+	else {
+	    string kind = item.substr(0, eq);
+	    int k;
+	    for (k = 0; k < NUM_KINDS; k++) {
+		if (kind == kind_name[k]) {
+		    opts.max_print[k] = val;
+		    break;
+		}
+	    }
+	    if (k >= NUM_KINDS) {
+		usage("bad kind for --max-print: " + kind);
+	    }
+	}
+	pos = end + 1;
+    }
+}
+
 // Command-line:  [options] ...  filename
 void
 getOptions(int argc, char **argv, Options & opts)
@@ -209,9 +279,141 @@ getOptions(int argc, char **argv, Options & opts)
 	    if (n + 1 >= argc) {
 	        usage("missing arg for -j");
 	    }
-	    opts.jobs = atoi(argv[n + 1]);
-	    if (opts.jobs <= 0 || opts.jobs > 550) {
-	        usage(string("bad arg for -j: ") + argv[n + 1]);
+	    if (string(argv[n + 1]) == "auto") {
+		opts.jobs_auto = true;
+		opts.jobs = 1;
+	    }
+	    else {
+		opts.jobs = atoi(argv[n + 1]);
+		if (opts.jobs <= 0 || opts.jobs > 550) {
+		    usage(string("bad arg for -j: ") + argv[n + 1]);
+		}
+		opts.jobs_auto = false;
+	    }
+	    n += 2;
+	}
+	else if (arg == "-J") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for -J");
+	    }
+	    opts.check_jobs = atoi(argv[n + 1]);
+	    if (opts.check_jobs <= 0 || opts.check_jobs > 550) {
+	        usage(string("bad arg for -J: ") + argv[n + 1]);
+	    }
+	    opts.check_jobs_set = true;
+	    n += 2;
+	}
+	else if (arg == "-jobs-profile" || arg == "--jobs-profile") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --jobs-profile");
+	    }
+	    opts.jobs_profile = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-numa" || arg == "--numa") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --numa");
+	    }
+	    string mode(argv[n + 1]);
+	    if (mode == "spread") {
+		opts.numa = NUMA_SPREAD;
+	    }
+	    else if (mode == "compact") {
+		opts.numa = NUMA_COMPACT;
+	    }
+	    else {
+	        usage("bad arg for --numa: " + mode);
+	    }
+	    n += 2;
+	}
+	else if (arg == "-input" || arg == "--input") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --input");
+	    }
+	    string format(argv[n + 1]);
+	    if (format == "elf") {
+		opts.input = INPUT_ELF;
+	    }
+	    else if (format == "jitdump") {
+		opts.input = INPUT_JITDUMP;
+	    }
+	    else if (format == "blob") {
+		opts.input = INPUT_BLOB;
+	    }
+	    else {
+	        usage("bad arg for --input: " + format);
+	    }
+	    n += 2;
+	}
+	else if (arg == "-numa-nodes" || arg == "--numa-nodes") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --numa-nodes");
+	    }
+	    opts.numa_nodes = argv[n + 1];
+	    if (opts.numa == NUMA_NONE) {
+		opts.numa = NUMA_SPREAD;
+	    }
+	    n += 2;
+	}
+	else if (arg == "-order" || arg == "--order") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --order");
+	    }
+	    string mode(argv[n + 1]);
+	    if (mode == "addr") {
+		opts.order_score = false;
+	    }
+	    else if (mode == "score") {
+		opts.order_score = true;
+	    }
+	    else {
+	        usage("bad arg for --order: " + mode);
+	    }
+	    n += 2;
+	}
+	else if (arg == "-fail-fast" || arg == "--fail-fast") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --fail-fast");
+	    }
+	    opts.fail_fast = atol(argv[n + 1]);
+	    if (opts.fail_fast <= 0) {
+	        usage(string("bad arg for --fail-fast: ") + argv[n + 1]);
+	    }
+	    n += 2;
+	}
+	else if (arg == "-objdump" || arg == "--objdump") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --objdump");
+	    }
+	    opts.objdump = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-boundaries" || arg == "--boundaries") {
+	    opts.boundaries = true;
+	    n++;
+	}
+	else if (arg == "-eh-frame" || arg == "--eh-frame") {
+	    opts.eh_frame = true;
+	    n++;
+	}
+	else if (arg == "-source" || arg == "--source") {
+	    opts.source = true;
+	    n++;
+	}
+	else if (arg == "-max-print" || arg == "--max-print") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --max-print");
+	    }
+	    parseMaxPrint(argv[n + 1], opts);
+	    n += 2;
+	}
+	else if (arg == "-sample" || arg == "--sample") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --sample");
+	    }
+	    opts.sample = atol(argv[n + 1]);
+	    if (opts.sample < 0) {
+	        usage(string("bad arg for --sample: ") + argv[n + 1]);
 	    }
 	    n += 2;
 	}
@@ -238,7 +440,141 @@ getOptions(int argc, char **argv, Options & opts)
 	    opts.fix_troll = false;
 	    n++;
 	}
-	else if (arg[0] == '-') {
+	else if (arg == "-diff-encodings" || arg == "--diff-encodings") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --diff-encodings");
+	    }
+	    opts.diff_old = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-builds" || arg == "--builds") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --builds");
+	    }
+	    opts.builds = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-xed-cache" || arg == "--xed-cache") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --xed-cache");
+	    }
+	    opts.xed_cache = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-kv-out" || arg == "--kv-out") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --kv-out");
+	    }
+	    opts.kv_out = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-corpus" || arg == "--corpus") {
+	    opts.corpus = true;
+	    n++;
+	}
+	else if (arg == "-maps" || arg == "--maps") {
+	    opts.corpus = true;
+	    opts.maps = true;
+	    n++;
+	}
+	else if (arg == "-archive" || arg == "--archive") {
+	    opts.corpus = true;
+	    opts.archive = true;
+	    n++;
+	}
+	else if (arg == "-in-process" || arg == "--in-process") {
+	    opts.in_process = true;
+	    n++;
+	}
+	else if (arg == "-profile" || arg == "--profile") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --profile");
+	    }
+	    opts.profile = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-verdicts" || arg == "--verdicts") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --verdicts");
+	    }
+	    opts.verdicts = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-hot" || arg == "--hot") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --hot");
+	    }
+	    opts.hot_pct = atof(argv[n + 1]);
+	    if (opts.hot_pct <= 0.0 || opts.hot_pct > 100.0) {
+	        usage(string("bad arg for --hot: ") + argv[n + 1]);
+	    }
+	    n += 2;
+	}
+	else if (arg == "-offsets" || arg == "--offsets") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --offsets");
+	    }
+	    opts.offsets = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-corpus-jobs" || arg == "--corpus-jobs") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --corpus-jobs");
+	    }
+	    opts.corpus_jobs = atoi(argv[n + 1]);
+	    if (opts.corpus_jobs <= 0 || opts.corpus_jobs > 550) {
+	        usage(string("bad arg for --corpus-jobs: ") + argv[n + 1]);
+	    }
+	    n += 2;
+	}
+	else if (arg == "-checkpoint" || arg == "--checkpoint") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --checkpoint");
+	    }
+	    opts.checkpoint = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-queue" || arg == "--queue") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --queue");
+	    }
+	    opts.queue = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-lease" || arg == "--lease") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --lease");
+	    }
+	    opts.lease_secs = atol(argv[n + 1]);
+	    if (opts.lease_secs <= 0) {
+	        usage(string("bad arg for --lease: ") + argv[n + 1]);
+	    }
+	    n += 2;
+	}
+	else if (arg == "-queue-merge" || arg == "--queue-merge") {
+	    opts.queue_merge = true;
+	    n++;
+	}
+	else if (arg == "-history" || arg == "--history") {
+	    if (n + 1 >= argc) {
+	        usage("missing arg for --history");
+	    }
+	    opts.history = argv[n + 1];
+	    n += 2;
+	}
+	else if (arg == "-history-report" || arg == "--history-report") {
+	    opts.history_report = true;
+	    n++;
+	}
+	else if (arg == "-clones" || arg == "--clones") {
+	    opts.clones = true;
+	    n++;
+	}
+	else if (arg == "-resume" || arg == "--resume") {
+	    opts.resume = true;
+	    n++;
+	}
+	else if (arg[0] == '-' && arg != "-") {
 	    usage("invalid option: " + arg);
 	}
 	else {
@@ -246,9 +582,47 @@ getOptions(int argc, char **argv, Options & opts)
 	}
     }
 
+    if (opts.resume && opts.checkpoint == NULL) {
+	usage("--resume requires --checkpoint");
+    }
+    if (opts.queue != NULL && ! opts.corpus) {
+	usage("--queue requires --corpus");
+    }
+    if (opts.input != INPUT_ELF && opts.corpus) {
+	usage("--input jitdump or blob does not work with --corpus");
+    }
+    if (opts.input != INPUT_ELF && opts.boundaries) {
+	usage("--input jitdump or blob does not work with --boundaries");
+    }
+    if (opts.input != INPUT_ELF && opts.eh_frame) {
+	usage("--input jitdump or blob does not work with --eh-frame");
+    }
+    if (opts.input != INPUT_ELF && opts.offsets != NULL) {
+	usage("--input jitdump or blob does not work with --offsets");
+    }
+    if (opts.maps && opts.queue != NULL) {
+	usage("--maps does not work with --queue");
+    }
+    if (opts.archive && (opts.maps || opts.queue != NULL)) {
+	usage("--archive does not work with --maps or --queue");
+    }
+    if (opts.in_process && (! opts.corpus || opts.queue != NULL || opts.numa != NUMA_NONE)) {
+	usage("--in-process requires --corpus, --maps or --archive, and no --queue or --numa");
+    }
+    if (opts.jobs_auto && (opts.in_process || opts.diff_old != NULL)) {
+	usage("-j auto does not work with --in-process or --diff-encodings");
+    }
+    if (opts.hot_pct < 100.0 && opts.profile == NULL) {
+	usage("--hot requires --profile");
+    }
+    if (opts.profile != NULL && opts.order_score) {
+	usage("--profile and --order score both set the phase 2 order");
+    }
+
     // filename (required)
     if (n < argc) {
 	opts.filename = argv[n];
+	opts.file_index = n;
     }
     else {
 	usage("missing file name");
@@ -257,387 +631,1965 @@ getOptions(int argc, char **argv, Options & opts)
 
 //----------------------------------------------------------------------
 
-// Verify invalid Dyninst buffers for valid XED instructions.
-// Three possibilities:
-//
-//  1. XED says valid instruction at beginning of buffer.
-//    This is an instruction that dyninst doesn't know about.
-//
-//  2. XED says invalid, but skip ahead a few bytes (troll) and XED
-//    says valid.  Likely dyninst has the length wrong on the previous
-//    instruction.
-//
-//  3. XED says error and trolling doesn't find anything.
+// Automatic thread counts (-j auto).
+//
+// Each run with --jobs-profile appends one record to the profile
+// file:  code bytes, function symbols, -j, -J, parse and check secs
+// and peak RSS.  For each phase, -j auto fits the time per code byte
+// to  a + b/j + c*j  by least squares over the records, where b is
+// the part that scales with threads and c is the cost of more threads
+// (contention, allocation), and picks the fewest threads within 2% of
+// the predicted minimum.  Parse threads are also capped by the memory
+// that a fitted  rss/byte = m0 + m1*j  model says will fit.
+//
+// With too few records (or too few distinct thread counts), it uses
+// rough defaults from the code size and the number of function
+// symbols.  Either way, it prints the choice and why.
+//
+#define JOBS_MIN_RECORDS  4
+#define JOBS_NEAR_MIN     1.02
+#define JOBS_MEM_FRAC     0.8
+
+class JobsRecord {
+public:
+    double  bytes;
+    long    syms;
+    int     jobs;
+    int     check_jobs;
+    double  parse_secs;
+    double  check_secs;
+    double  maxrss_kb;
+};
+
+// Read the --jobs-profile records, a missing file is just empty.
+static void
+readJobsProfile(const char * path, vector <JobsRecord> & records)
+{
+    FILE * fp = fopen(path, "r");
+    char line[1024];
+
+    if (fp == NULL) {
+	return;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	JobsRecord rec;
+
+	if (line[0] == '#') {
+	    continue;
+	}
+	if (sscanf(line, "%lf %ld %d %d %lf %lf %lf", &rec.bytes, &rec.syms,
+		   &rec.jobs, &rec.check_jobs, &rec.parse_secs, &rec.check_secs,
+		   &rec.maxrss_kb) == 7
+	    && rec.bytes > 0 && rec.jobs > 0 && rec.check_jobs > 0) {
+	    records.push_back(rec);
+	}
+    }
+    fclose(fp);
+}
+
+// Append one record, a single write() with O_APPEND so that corpus
+// children can share the file.
+static void
+appendJobsProfile(const char * path, double bytes, long syms, double parse_secs,
+		  double check_secs)
+{
+    struct rusage usage;
+    struct stat sb;
+    char buf[1024];
+    int len = 0;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+	warn("unable to open jobs profile: %s", path);
+	return;
+    }
+    if (fstat(fd, &sb) == 0 && sb.st_size == 0) {
+	len = snprintf(buf, sizeof(buf), "# unknown-x86 jobs profile:  code-bytes  func-syms"
+		       "  jobs  check-jobs  parse-secs  check-secs  maxrss-kb\n");
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "%.0f %ld %d %d %.3f %.3f %ld\n",
+		    bytes, syms, opts.jobs, opts.check_jobs, parse_secs, check_secs,
+		    (long) usage.ru_maxrss);
+
+    if (write(fd, buf, len) != len) {
+	warn("write failed for jobs profile: %s", path);
+    }
+    close(fd);
+}
+
+// Least squares fit of y = coef[0] + coef[1]/j + coef[2]*j to the
+// (j, y) points.  Returns false if the normal equations are singular,
+// eg, fewer than 3 distinct values of j.
+static bool
+fitScaling(const vector <pair <double, double>> & pts, double coef[3])
+{
+    double mat[3][4];
+
+    for (int r = 0; r < 3; r++) {
+	for (int c = 0; c < 4; c++) {
+	    mat[r][c] = 0.0;
+	}
+    }
+    for (auto it = pts.begin(); it != pts.end(); ++it) {
+	double x[3] = { 1.0, 1.0 / it->first, it->first };
+
+	for (int r = 0; r < 3; r++) {
+	    for (int c = 0; c < 3; c++) {
+		mat[r][c] += x[r] * x[c];
+	    }
+	    mat[r][3] += x[r] * it->second;
+	}
+    }
+
+    // gaussian elimination with partial pivoting
+    for (int k = 0; k < 3; k++) {
+	int piv = k;
+	for (int r = k + 1; r < 3; r++) {
+	    if (fabs(mat[r][k]) > fabs(mat[piv][k])) {
+		piv = r;
+	    }
+	}
+	if (fabs(mat[piv][k]) < 1e-12 * (1.0 + fabs(mat[0][0]))) {
+	    return false;
+	}
+	for (int c = 0; c < 4; c++) {
+	    std::swap(mat[k][c], mat[piv][c]);
+	}
+	for (int r = 0; r < 3; r++) {
+	    if (r != k) {
+		double f = mat[r][k] / mat[k][k];
+		for (int c = k; c < 4; c++) {
+		    mat[r][c] -= f * mat[k][c];
+		}
+	    }
+	}
+    }
+    for (int k = 0; k < 3; k++) {
+	coef[k] = mat[k][3] / mat[k][k];
+    }
+    return true;
+}
+
+// Return the fewest threads in [1, max_jobs] whose predicted time is
+// within JOBS_NEAR_MIN of the minimum.
+static int
+bestJobs(const double coef[3], int max_jobs, double & pred)
+{
+    double best = 0.0;
+    vector <double> time(max_jobs + 1);
+
+    for (int j = 1; j <= max_jobs; j++) {
+	time[j] = coef[0] + coef[1] / j + coef[2] * j;
+	if (j == 1 || time[j] < best) {
+	    best = time[j];
+	}
+    }
+    for (int j = 1; j <= max_jobs; j++) {
+	if (time[j] <= best * JOBS_NEAR_MIN) {
+	    pred = time[j];
+	    return j;
+	}
+    }
+    pred = time[max_jobs];
+    return max_jobs;
+}
+
+// Return MemAvailable from /proc/meminfo in KB, or 0 if unknown.
+static double
+memAvailableKB()
+{
+    FILE * fp = fopen("/proc/meminfo", "r");
+    char line[256];
+    double kb = 0.0;
+
+    if (fp == NULL) {
+	return 0.0;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if (sscanf(line, "MemAvailable: %lf", &kb) == 1) {
+	    break;
+	}
+    }
+    fclose(fp);
+    return kb;
+}
+
+// Pick opts.jobs, and opts.check_jobs unless -J was given, for a
+// file with bytes of code and syms function symbols, and print the
+// choice and why.
+static void
+chooseJobs(double bytes, long syms)
+{
+    cpu_set_t allowed;
+    int cores = 1;
+
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+	cores = std::max(CPU_COUNT(&allowed), 1);
+    }
+    // corpus children run side by side
+    if (opts.corpus) {
+	cores = std::max(cores / opts.corpus_jobs, 1);
+    }
+    double avail_kb = memAvailableKB();
+
+    vector <JobsRecord> records;
+    vector <pair <double, double>> parsePts, checkPts;
+    set <int> parseJobs, checkJobs;
+    int max_parse = 1, max_check = 1;
+
+    if (opts.jobs_profile != NULL) {
+	readJobsProfile(opts.jobs_profile, records);
+    }
+    for (auto it = records.begin(); it != records.end(); ++it) {
+	parsePts.push_back(make_pair(it->jobs, it->parse_secs / it->bytes));
+	checkPts.push_back(make_pair(it->check_jobs, it->check_secs / it->bytes));
+	parseJobs.insert(it->jobs);
+	checkJobs.insert(it->check_jobs);
+	max_parse = std::max(max_parse, it->jobs);
+	max_check = std::max(max_check, it->check_jobs);
+    }
+
+    // don't extrapolate far past the thread counts we have seen
+    int parse_limit = std::min(cores, 2 * max_parse);
+    int check_limit = std::min(cores, 2 * max_check);
+
+    double coef[3], pred;
+    char parse_why[500], check_why[500], mem_why[200];
+
+    // parse threads
+    if (records.size() >= JOBS_MIN_RECORDS && parseJobs.size() >= 3
+	&& fitScaling(parsePts, coef)) {
+	opts.jobs = bestJobs(coef, parse_limit, pred);
+	snprintf(parse_why, sizeof(parse_why),
+		 "fitted from %ld runs, predicted %.2f sec (1 thread: %.2f sec)",
+		 (long) records.size(), pred * bytes, (coef[0] + coef[1] + coef[2]) * bytes);
+    }
+    else {
+	// about one thread per MB of code and 32 function symbols
+	// per thread, dyninst parse rarely scales past 16
+	long by_size = (long) (bytes / (1024 * 1024)) + 1;
+	long jobs = std::min(by_size, (long) std::min(cores, 16));
+	if (syms > 0) {
+	    jobs = std::min(jobs, std::max(syms / 32, 1L));
+	}
+	opts.jobs = std::max(jobs, 1L);
+	snprintf(parse_why, sizeof(parse_why),
+		 "default (%ld runs in profile), one thread per MB of code and 32 func"
+		 " symbols, at most %d", (long) records.size(), std::min(cores, 16));
+    }
+
+    // memory cap on parse threads, rss per code byte = m0 + m1*j
+    double m0 = 60.0 / 1024, m1 = 0.0;
+    double sum_j = 0.0, sum_y = 0.0, sum_jj = 0.0, sum_jy = 0.0;
+    long num_mem = 0;
+
+    for (auto it = records.begin(); it != records.end(); ++it) {
+	if (it->maxrss_kb > 0) {
+	    double y = it->maxrss_kb / it->bytes;
+	    sum_j += it->jobs;  sum_y += y;
+	    sum_jj += (double) it->jobs * it->jobs;  sum_jy += it->jobs * y;
+	    num_mem++;
+	}
+    }
+    double det = num_mem * sum_jj - sum_j * sum_j;
+    if (num_mem >= JOBS_MIN_RECORDS && parseJobs.size() >= 2 && det > 0.0) {
+	m1 = std::max((num_mem * sum_jy - sum_j * sum_y) / det, 0.0);
+	m0 = std::max((sum_y - m1 * sum_j) / num_mem, 0.0);
+	snprintf(mem_why, sizeof(mem_why), "fitted rss");
+    }
+    else {
+	snprintf(mem_why, sizeof(mem_why), "default rss of 60 bytes per code byte");
+    }
+    if (avail_kb > 0.0) {
+	while (opts.jobs > 1 && bytes * (m0 + m1 * opts.jobs) > JOBS_MEM_FRAC * avail_kb) {
+	    opts.jobs--;
+	}
+    }
+
+    // phase 2 threads
+    if (! opts.check_jobs_set) {
+	if (records.size() >= JOBS_MIN_RECORDS && checkJobs.size() >= 3
+	    && fitScaling(checkPts, coef)) {
+	    opts.check_jobs = bestJobs(coef, check_limit, pred);
+	    snprintf(check_why, sizeof(check_why),
+		     "fitted from %ld runs, predicted %.2f sec (1 thread: %.2f sec)",
+		     (long) records.size(), pred * bytes, (coef[0] + coef[1] + coef[2]) * bytes);
+	}
+	else {
+	    // phase 2 is independent per function and scales well
+	    long jobs = std::min((long) (bytes / (256 * 1024)) + 1, (long) cores);
+	    opts.check_jobs = std::max(jobs, 1L);
+	    snprintf(check_why, sizeof(check_why),
+		     "default, one thread per 256 KB of code, at most %d", cores);
+	}
+    }
+    else {
+	snprintf(check_why, sizeof(check_why), "set by -J");
+    }
+
+    printf("\njobs auto:  -j %d  -J %d\n"
+	   "  code: %.1f MB  func symbols: %ld  cores: %d  mem available: %.1f GB\n"
+	   "  parse: %s\n"
+	   "  memory: %s, predicted %.1f GB\n"
+	   "  check: %s\n",
+	   opts.jobs, opts.check_jobs, bytes / 1048576.0, syms, cores,
+	   avail_kb / 1048576.0, parse_why, mem_why,
+	   bytes * (m0 + m1 * opts.jobs) / 1048576.0, check_why);
+    fflush(stdout);
+}
+
+//----------------------------------------------------------------------
+
+// Phase 2 order (--order score).  Put the functions most likely to
+// have problems first, so that a broken dyninst shows up in seconds.
+// The score is the fraction of function bytes that are VEX or EVEX
+// prefixes (0xc4, 0xc5, 0x62), plus 1.0 if the function hit the
+// unknown callback in phase 1.  Counting prefix bytes without
+// decoding overcounts a little, but is cheap.
+//
+// Map the unknown callback addresses to the function with the last
+// block starting at or before the address (dyninst ends the block at
+// the unknown instruction).
+//
+static void
+orderByScore(vector <ParseAPI::Function *> & funcVec, CodeSource * code_src)
+{
+    long num_funcs = funcVec.size();
+    vector <double> score(num_funcs, 0.0);
+
+#pragma omp parallel for schedule(dynamic, 16) num_threads(ctx->check_jobs)
+    for (long n = 0; n < num_funcs; n++) {
+	const ParseAPI::Function::blocklist & blist = funcVec[n]->blocks();
+	long num_bytes = 0;
+	long num_vex = 0;
+
+	for (auto bit = blist.begin(); bit != blist.end(); ++bit) {
+	    Block * block = *bit;
+	    const uint8_t * ptr = (const uint8_t *) code_src->getPtrToInstruction(block->start());
+
+	    if (ptr == NULL) {
+		continue;
+	    }
+	    for (long i = 0; i < (long) block->size(); i++) {
+		num_vex += (ptr[i] == 0x62 || ptr[i] == 0xc4 || ptr[i] == 0xc5);
+	    }
+	    num_bytes += block->size();
+	}
+	score[n] = (num_bytes > 0) ? (double) num_vex / num_bytes : 0.0;
+    }
+
+    vector <Address> unknownAddrs;
+    getUnknownAddrs(code_src, unknownAddrs);
+
+    // addresses to functions, by the last block start <= addr
+    vector <pair <Address, long>> blockStart;
+
+    for (long n = 0; n < num_funcs; n++) {
+	const ParseAPI::Function::blocklist & blist = funcVec[n]->blocks();
+	for (auto bit = blist.begin(); bit != blist.end(); ++bit) {
+	    blockStart.push_back(make_pair((*bit)->start(), n));
+	}
+    }
+    std::sort(blockStart.begin(), blockStart.end());
+
+    long num_hit = 0;
+    for (auto ait = unknownAddrs.begin(); ait != unknownAddrs.end(); ++ait) {
+	auto it = std::upper_bound(blockStart.begin(), blockStart.end(),
+				   make_pair(*ait, LONG_MAX));
+	if (it != blockStart.begin()) {
+	    --it;
+	    if (score[it->second] < 1.0) {
+		score[it->second] += 1.0;
+		num_hit++;
+	    }
+	}
+    }
+
+    // sort by score, high to low, ties stay in address order
+    vector <long> index(num_funcs);
+    for (long n = 0; n < num_funcs; n++) {
+	index[n] = n;
+    }
+    std::stable_sort(index.begin(), index.end(),
+		     [&score](long a, long b) { return score[a] > score[b]; });
+
+    vector <ParseAPI::Function *> sorted(num_funcs);
+    for (long n = 0; n < num_funcs; n++) {
+	sorted[n] = funcVec[index[n]];
+    }
+    funcVec.swap(sorted);
+
+    if (! opts.quiet) {
+	cout << "order by score: " << num_hit << " functions hit the unknown callback\n" << endl;
+    }
+}
+
+//----------------------------------------------------------------------
+
+// Source attribution (--source).
+//
+// Collect all the finding addresses, sort them, and resolve them
+// against the DWARF line tables of every compile unit (module) in
+// one merge pass, instead of a lookup per address.  Each line table
+// row gives the compile unit and file:line for [start, end).  File
+// names are interned since most rows share a few files.
+//
+class LineRow {
+public:
+    Address  start;
+    Address  end;
+    int   cu;
+    int   file;
+    unsigned int  line;
+
+    bool operator < (const LineRow & other) const {
+	return start < other.start;
+    }
+};
+
+static void
+printSourceAttribution(vector <Finding> & findings)
+{
+    vector <Module *> modules;
+    vector <string> cuNames;
+    vector <string> fileNames;
+    unordered_map <string, int> fileIndex;
+    vector <LineRow> rows;
+
+    // no line info for jitdump or blob input
+    if (ctx->symtab != NULL) {
+	ctx->symtab->getAllModules(modules);
+    }
+
+    for (auto mit = modules.begin(); mit != modules.end(); ++mit) {
+	Module * mod = *mit;
+	LineInformation * info = mod->parseLineInformation();
+
+	if (info == NULL) {
+	    continue;
+	}
+	int cu = cuNames.size();
+	cuNames.push_back(mod->fileName());
+
+	for (auto it = info->begin(); it != info->end(); ++it) {
+	    LineRow row;
+	    string file = (*it)->getFile();
+	    auto fit = fileIndex.find(file);
+
+	    if (fit == fileIndex.end()) {
+		fit = fileIndex.insert(make_pair(file, (int) fileNames.size())).first;
+		fileNames.push_back(file);
+	    }
+	    row.start = (*it)->startAddr();
+	    row.end = (*it)->endAddr();
+	    row.cu = cu;
+	    row.file = fit->second;
+	    row.line = (*it)->getLine();
+
+	    if (row.end > row.start) {
+		rows.push_back(row);
+	    }
+	}
+    }
+
+    std::sort(rows.begin(), rows.end());
+    std::sort(findings.begin(), findings.end(), FindingLessThan);
+
+    // rows can overlap (across compile units and in inlined code), so
+    // the last row that starts at or before addr may end before it
+    // while an earlier, longer row still covers it.  maxEnd[k] is the
+    // largest end in rows[0..k], and the backward walk stops as soon
+    // as no earlier row can reach addr.
+    vector <Address> maxEnd(rows.size());
+    for (long k = 0; k < (long) rows.size(); k++) {
+	maxEnd[k] = (k > 0) ? std::max(maxEnd[k - 1], rows[k].end) : rows[k].end;
+    }
+
+    // merge pass, rows[j - 1] is the last row with start <= addr
+    vector <long> cuCount(cuNames.size(), 0);
+    long num_unresolved = 0;
+    long j = 0;
+
+    printf("\nsource attribution (%ld findings, %ld line rows):\n",
+	   (long) findings.size(), (long) rows.size());
+
+    for (auto it = findings.begin(); it != findings.end(); ++it) {
+	while (j < (long) rows.size() && rows[j].start <= it->addr) {
+	    j++;
+	}
+	const LineRow * row = NULL;
+	for (long k = j - 1; k >= 0 && it->addr < maxEnd[k]; k--) {
+	    if (it->addr < rows[k].end) {
+		row = &rows[k];
+		break;
+	    }
+	}
+
+	if (row == NULL) {
+	    num_unresolved++;
+	    if (! opts.quiet) {
+		printf("%-8s  0x%lx  (no line info)\n", kind_name[it->kind], it->addr);
+	    }
+	    continue;
+	}
+	cuCount[row->cu]++;
+	if (! opts.quiet) {
+	    printf("%-8s  0x%lx  cu: %s  line: %s:%u\n", kind_name[it->kind], it->addr,
+		   cuNames[row->cu].c_str(), fileNames[row->file].c_str(), row->line);
+	}
+    }
+
+    // compile units with the most findings first
+    vector <pair <long, int>> order;
+    for (int cu = 0; cu < (int) cuNames.size(); cu++) {
+	if (cuCount[cu] > 0) {
+	    order.push_back(make_pair(- cuCount[cu], cu));
+	}
+    }
+    std::sort(order.begin(), order.end());
+
+    printf("\nfindings by compile unit:\n");
+    for (auto it = order.begin(); it != order.end(); ++it) {
+	printf("%8ld  %s\n", - it->first, cuNames[it->second].c_str());
+    }
+    if (num_unresolved > 0) {
+	printf("%8ld  (no line info)\n", num_unresolved);
+    }
+}
+
+//----------------------------------------------------------------------
+
+// Findings by function (see buildBlockIndex()).
+//
+// Count the findings of each kind in each function.  Gaps under
+// BIG_GAP_SIZE are usually just alignment and are not counted.
+#define BIG_GAP_SIZE  64
+
+static void
+mapFindings(vector <Finding> & findings,
+	    unordered_map <ParseAPI::Function *, vector <long>> & problems)
+{
+    vector <Address> addrs;
+
+    std::sort(findings.begin(), findings.end(), FindingLessThan);
+
+    for (auto it = findings.begin(); it != findings.end(); ++it) {
+	addrs.push_back(it->addr);
+    }
+    mergeBlockIndex(addrs,
+		    [&findings](long n) { return findings[n].kind == KIND_UNKNOWN; },
+		    [&](ParseAPI::Function * func, long n) {
+			if (findings[n].kind == KIND_GAP && findings[n].size < BIG_GAP_SIZE) {
+			    return;
+			}
+			vector <long> & vec = problems[func];
+			if (vec.empty()) {
+			    vec.resize(NUM_KINDS, 0);
+			}
+			vec[findings[n].kind]++;
+		    });
+}
+
+//----------------------------------------------------------------------
+
+// Profile weights (--profile).
+//
+// The profile is address and count lines (eg, post-processed perf
+// script output), addresses as in the binary.  The samples are
+// sorted and merged against the block index to get the samples per
+// function.  Phase 2 checks the hottest functions first (or only
+// those covering the top --hot percent), and the summary weights the
+// functions with problems by their samples.
+//
+static void
+readProfile(const char * path)
+{
+    FILE * fp = fopen(path, "r");
+    char line[4096];
+
+    if (fp == NULL) {
+	err(1, "unable to open profile: %s", path);
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	char * ptr = line;
+	char * end = NULL;
+
+	while (isspace(*ptr)) {
+	    ptr++;
+	}
+	if (*ptr == 0 || *ptr == '#') {
+	    continue;
+	}
+	Address addr = strtoul(ptr, &end, 16);
+	if (end == ptr) {
+	    continue;
+	}
+	ptr = end;
+	long count = strtol(ptr, &end, 10);
+	if (end == ptr) {
+	    count = 1;
+	}
+	if (count > 0) {
+	    ctx->profile_samples.push_back(make_pair(addr, count));
+	    ctx->profile_total += count;
+	}
+    }
+    fclose(fp);
+
+    std::sort(ctx->profile_samples.begin(), ctx->profile_samples.end());
+}
+
+static bool
+FuncSamplesGreater(ParseAPI::Function * f1, ParseAPI::Function * f2)
+{
+    return ctx->func_samples[f1] > ctx->func_samples[f2];
+}
+
+// Put the functions with samples first, hottest first, and with
+// --hot, drop the functions past the top hot_pct of samples.
+static void
+orderByProfile(vector <ParseAPI::Function *> & funcVec)
+{
+    vector <Address> addrs;
+
+    for (auto it = ctx->profile_samples.begin(); it != ctx->profile_samples.end(); ++it) {
+	addrs.push_back(it->first);
+    }
+    mergeBlockIndex(addrs,
+		    [](ParseAPI::Function * func, long n) {
+			ctx->func_samples[func] += ctx->profile_samples[n].second;
+		    });
+
+    // the index has all functions, only count the ones in funcVec
+    for (auto fit = funcVec.begin(); fit != funcVec.end(); ++fit) {
+	ctx->profile_mapped += ctx->func_samples[*fit];
+    }
+
+    std::stable_sort(funcVec.begin(), funcVec.end(), FuncSamplesGreater);
+
+    if (opts.hot_pct < 100.0) {
+	double limit = opts.hot_pct * ctx->profile_mapped / 100.0;
+	long sum = 0;
+	long num = 0;
+
+	while (num < (long) funcVec.size() && sum < limit
+	       && ctx->func_samples[funcVec[num]] > 0) {
+	    sum += ctx->func_samples[funcVec[num]];
+	    num++;
+	}
+	funcVec.resize(num);
+    }
+}
+
+// Weighted summary: samples in the checked functions with and
+// without problems (unknown, bad length, block errors), the samples
+// by kind, and the hottest functions with problems.
+static void
+printProfileSummary(vector <ParseAPI::Function *> & funcVec, vector <Finding> & findings)
+{
+    unordered_map <ParseAPI::Function *, vector <long>> problems;
+
+    mapFindings(findings, problems);
+
+    long checked = 0;
+    long bad = 0;
+    long kind_samples[NUM_KINDS] = { 0 };
+    vector <ParseAPI::Function *> hotBad;
+
+    for (auto fit = funcVec.begin(); fit != funcVec.end(); ++fit) {
+	long samples = ctx->func_samples[*fit];
+	auto pit = problems.find(*fit);
+
+	checked += samples;
+	if (pit == problems.end()) {
+	    continue;
+	}
+	for (int k = 0; k < NUM_KINDS; k++) {
+	    if (pit->second[k] > 0) {
+		kind_samples[k] += samples;
+	    }
+	}
+
+	// same as --fail-fast, gaps are often just alignment
+	vector <long> & vec = pit->second;
+	if (vec[KIND_UNKNOWN] + vec[KIND_BAD_LENGTH] + vec[KIND_BLOCK] > 0) {
+	    bad += samples;
+	    if (samples > 0) {
+		hotBad.push_back(*fit);
+	    }
+	}
+    }
+
+    printf("\nprofile: %s  samples: %ld  in funcs: %ld (%.1f%%)  checked: %ld\n",
+	   opts.profile, ctx->profile_total, ctx->profile_mapped,
+	   (ctx->profile_total > 0) ? 100.0 * ctx->profile_mapped / ctx->profile_total : 0.0, checked);
+
+    printf("hot-code correctness: %.2f%%  (samples in funcs with problems: %ld)\n",
+	   (checked > 0) ? 100.0 * (checked - bad) / checked : 100.0, bad);
+
+    printf("weighted:");
+    for (int k = 0; k < NUM_KINDS; k++) {
+	printf("  %s: %ld", kind_name[k], kind_samples[k]);
+    }
+    printf("\n");
+
+    // funcVec is already hottest first
+    long num = std::min((long) hotBad.size(), 10L);
+    for (long n = 0; n < num; n++) {
+	ParseAPI::Function * func = hotBad[n];
+	vector <long> & vec = problems[func];
+
+	printf("  0x%lx  samples: %ld  unknown: %ld  bad: %ld  block: %ld  gap: %ld  %s\n",
+	       func->addr(), ctx->func_samples[func], vec[KIND_UNKNOWN], vec[KIND_BAD_LENGTH],
+	       vec[KIND_BLOCK], vec[KIND_GAP] + vec[KIND_OVERLAP], func->name().c_str());
+    }
+}
+
+//----------------------------------------------------------------------
+
+// Function verdict table (--verdicts).
+//
+// Write one record per function (entry address and VERDICT_* flags)
+// in the format of verdict-table.h, sorted by entry, so that an
+// instrumenter can mmap the table and skip the functions with a
+// broken CFG with a binary search.
+//
+static void
+writeVerdicts(const char * path, vector <ParseAPI::Function *> & allFuncs,
+	      vector <ParseAPI::Function *> & funcVec, vector <Finding> & findings)
+{
+    unordered_map <ParseAPI::Function *, vector <long>> problems;
+    unordered_set <ParseAPI::Function *> checked(funcVec.begin(), funcVec.end());
+    vector <verdict_record> records;
+    long kind_funcs[6] = { 0 };   // ok, then one per VERDICT_* bit
+
+    mapFindings(findings, problems);
+
+    // if phase 3 only saw some of the functions, then a gap may just
+    // be an unchecked function, so don't count it as truncated
+    bool all_checked = (funcVec.size() == allFuncs.size());
+
+    // allFuncs is sorted by entry address
+    for (auto fit = allFuncs.begin(); fit != allFuncs.end(); ++fit) {
+	verdict_record rec;
+	auto pit = problems.find(*fit);
+
+	rec.entry = (*fit)->addr();
+	rec.flags = VERDICT_OK;
+	rec.num_problems = 0;
+
+	if (pit != problems.end()) {
+	    vector <long> & vec = pit->second;
+
+	    if (vec[KIND_UNKNOWN] > 0)     { rec.flags |= VERDICT_UNKNOWN; }
+	    if (vec[KIND_BAD_LENGTH] > 0)  { rec.flags |= VERDICT_BAD_LENGTH; }
+	    if (vec[KIND_BLOCK] > 0)       { rec.flags |= VERDICT_TRUNCATED; }
+	    if (vec[KIND_GAP] > 0 && all_checked) { rec.flags |= VERDICT_TRUNCATED; }
+	    if (vec[KIND_OVERLAP] > 0)     { rec.flags |= VERDICT_OVERLAP; }
+
+	    for (int k = 0; k < NUM_KINDS; k++) {
+		rec.num_problems += vec[k];
+	    }
+	}
+	if (checked.count(*fit) == 0) {
+	    rec.flags |= VERDICT_UNCHECKED;
+	}
+
+	if (rec.flags == VERDICT_OK) {
+	    kind_funcs[0]++;
+	}
+	for (int b = 0; b < 5; b++) {
+	    if (rec.flags & (1 << b)) {
+		kind_funcs[b + 1]++;
+	    }
+	}
+	records.push_back(rec);
+    }
+
+    verdict_header hdr;
+    struct stat sb;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, VERDICT_MAGIC, 8);
+    hdr.version = VERDICT_VERSION;
+    hdr.record_size = sizeof(verdict_record);
+    hdr.num_records = records.size();
+    if (ctx->mem_image != NULL) {
+	hdr.file_size = ctx->mem_image_size;
+    }
+    else {
+	hdr.file_size = (stat(ctx->filename, &sb) == 0) ? sb.st_size : 0;
+    }
+
+    string tmp = string(path) + ".tmp." + to_string(getpid());
+    FILE * fp = fopen(tmp.c_str(), "w");
+
+    if (fp == NULL) {
+	warn("unable to write verdicts file: %s", tmp.c_str());
+	return;
+    }
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    fwrite(records.data(), sizeof(verdict_record), records.size(), fp);
+
+    if (fclose(fp) != 0 || rename(tmp.c_str(), path) != 0) {
+	warn("unable to write verdicts file: %s", path);
+	unlink(tmp.c_str());
+	return;
+    }
+
+    printf("\nverdicts: %s  funcs: %ld  ok: %ld  unknown: %ld  bad: %ld  truncated: %ld"
+	   "  overlap: %ld  unchecked: %ld\n",
+	   path, (long) records.size(), kind_funcs[0], kind_funcs[1], kind_funcs[2],
+	   kind_funcs[3], kind_funcs[4], kind_funcs[5]);
+}
+
+//----------------------------------------------------------------------
+
+// Write the summary as key=value lines (--kv-out), for the
+// multi-build driver and other scripts.
+//
+static void
+writeKeyValues(const char * path, long num_funcs)
+{
+    FILE * fp = fopen(path, "w");
+    struct rusage usage;
+
+    if (fp == NULL) {
+	warn("unable to open kv file: %s", path);
+	return;
+    }
+    getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(fp, "file=%s\n", ctx->filename);
+    if (ctx->offsets != NULL) {
+	fprintf(fp, "offsets=%s\n", ctx->offsets);
+    }
+    fprintf(fp, "parse_secs=%.3f\n", ctx->parse_secs);
+    fprintf(fp, "check_secs=%.3f\n", ctx->check_secs);
+    fprintf(fp, "gaps_secs=%.3f\n", ctx->gaps_secs);
+    fprintf(fp, "parse_cpu=%.3f\n", ctx->parse_cpu);
+    fprintf(fp, "check_cpu=%.3f\n", ctx->check_cpu);
+    fprintf(fp, "gaps_cpu=%.3f\n", ctx->gaps_cpu);
+    fprintf(fp, "max_threads=%ld\n", ctx->max_threads);
+    fprintf(fp, "maxrss_kb=%ld\n", (long) usage.ru_maxrss);
+    fprintf(fp, "funcs=%ld\n", num_funcs);
+    fprintf(fp, "blocks=%ld\n", ctx->check_stats.num_blocks);
+    fprintf(fp, "instns=%ld\n", ctx->check_stats.num_instns);
+    fprintf(fp, "bytes=%ld\n", ctx->check_stats.num_bytes);
+    fprintf(fp, "code_bytes=%ld\n", ctx->code_bytes);
+    fprintf(fp, "covered_bytes=%ld\n", ctx->covered_bytes);
+    fprintf(fp, "unknown=%ld\n", ctx->num_unknown);
+    fprintf(fp, "unknown_valid=%ld\n", ctx->num_unknown_valid);
+    fprintf(fp, "unknown_troll=%ld\n", ctx->num_unknown_troll);
+    fprintf(fp, "unknown_error=%ld\n", ctx->num_unknown_error);
+    fprintf(fp, "bad_length=%ld\n", ctx->check_stats.num_bad_length);
+    fprintf(fp, "desync=%ld\n", ctx->check_stats.num_desync);
+    fprintf(fp, "block_errors=%ld\n",
+	    ctx->check_stats.num_block_align_errors + ctx->check_stats.num_block_length_errors);
+    fprintf(fp, "gaps=%ld\n", ctx->num_gaps);
+    fprintf(fp, "gap_bytes=%ld\n", ctx->size_gaps);
+    fprintf(fp, "overlap=%ld\n", ctx->num_overlap);
+    fprintf(fp, "xed_cache_hits=%ld\n", ctx->check_stats.num_cache_hits);
+
+    fclose(fp);
+}
+
+// Read key=value lines into a map.
+void
+readKeyValues(const char * path, map <string, string> & kv)
+{
+    FILE * fp = fopen(path, "r");
+    char line[4096];
+
+    if (fp == NULL) {
+	return;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	string str(line);
+	size_t eq = str.find('=');
+
+	if (eq == string::npos) {
+	    continue;
+	}
+	while (! str.empty() && (str.back() == '\n' || str.back() == '\r')) {
+	    str.pop_back();
+	}
+	kv[str.substr(0, eq)] = str.substr(eq + 1);
+    }
+    fclose(fp);
+}
+
+//----------------------------------------------------------------------
+
+// The options that change a file's results, for matching checkpoint,
+// queue, archive and history records.  The profile and objdump files go in by
+// content hash, not path, so workers on other nodes agree.
+string
+optionsKey()
+{
+    string key;
+
+    bufPrintf(key, "fix_valid=%d,fix_troll=%d,eh_frame=%d,clones=%d,fail_fast=%ld",
+	      opts.fix_valid, opts.fix_troll, opts.eh_frame, opts.clones, opts.fail_fast);
+
+    if (opts.fail_fast > 0) {
+	bufPrintf(key, ",order_score=%d", opts.order_score);
+    }
+    if (opts.profile != NULL) {
+	bufPrintf(key, ",profile=%016lx,hot=%g",
+		  (unsigned long) hashFile(opts.profile), opts.hot_pct);
+    }
+    if (opts.offsets != NULL) {
+	bufPrintf(key, ",offsets=%s", opts.offsets);
+    }
+    if (opts.boundaries) {
+	bufPrintf(key, ",boundaries=1");
+    }
+    if (opts.objdump != NULL) {
+	bufPrintf(key, ",objdump=%016lx", (unsigned long) hashFile(opts.objdump));
+    }
+
+    return key;
+}
+
+//----------------------------------------------------------------------
+
+// In-memory code input (--input jitdump or blob).
+//
+// JIT code in perf jitdump files or raw memory dumps is not an ELF
+// file, so Symtab can't read it.  Instead, map the file and build a
+// ParseAPI CodeSource directly: one region per code load (or blob)
+// pointing into the mapping, and one function hint per region.
+// Then the same three phases run on it.
+//
+class MemRegion : public CodeRegion {
+public:
+    Address  start;
+    Address  size;
+    const unsigned char *  ptr;
+    string  name;
+
+    MemRegion(Address st, Address sz, const unsigned char * p, const string & nm)
+	: start(st), size(sz), ptr(p), name(nm) { }
+
+    void names(const Address, vector <string> & vec) { vec.push_back(name); }
+
+    bool isValidAddress(const Address addr) const {
+	return addr >= start && addr < start + size;
+    }
+    void * getPtrToInstruction(const Address addr) const {
+	return isValidAddress(addr) ? (void *) (ptr + (addr - start)) : NULL;
+    }
+    void * getPtrToData(const Address addr) const { return getPtrToInstruction(addr); }
+    unsigned int getAddressWidth() const { return 8; }
+    bool isCode(const Address addr) const { return isValidAddress(addr); }
+    bool isData(const Address) const { return false; }
+    bool isReadOnly(const Address) const { return true; }
+    Address offset() const { return start; }
+    Address length() const { return size; }
+    Architecture getArch() const { return Arch_x86_64; }
+    Address low() const { return start; }
+    Address high() const { return start + size; }
+};
+
+static bool
+MemRegionLessThan(MemRegion * r1, MemRegion * r2)
+{
+    return r1->start < r2->start;
+}
+
+// The regions are sorted and disjoint, so an address lookup is a
+// binary search.
+class MemCodeSource : public CodeSource {
+private:
+    vector <MemRegion *> mem_regions;
+
+    MemRegion * findRegion(const Address addr) const {
+	auto it = std::upper_bound(mem_regions.begin(), mem_regions.end(), addr,
+				   [](Address a, MemRegion * r) { return a < r->start; });
+	if (it == mem_regions.begin()) {
+	    return NULL;
+	}
+	--it;
+	return (*it)->isValidAddress(addr) ? *it : NULL;
+    }
+
+public:
+    MemCodeSource(vector <MemRegion *> & regions) : mem_regions(regions) {
+	for (auto it = mem_regions.begin(); it != mem_regions.end(); ++it) {
+	    addRegion(*it);
+	    _hints.push_back(Hint((*it)->start, 0, *it, (*it)->name));
+	}
+    }
+
+    bool isValidAddress(const Address addr) const { return findRegion(addr) != NULL; }
+    void * getPtrToInstruction(const Address addr) const {
+	MemRegion * reg = findRegion(addr);
+	return (reg != NULL) ? reg->getPtrToInstruction(addr) : NULL;
+    }
+    void * getPtrToData(const Address addr) const { return getPtrToInstruction(addr); }
+    unsigned int getAddressWidth() const { return 8; }
+    bool isCode(const Address addr) const { return isValidAddress(addr); }
+    bool isData(const Address) const { return false; }
+    bool isReadOnly(const Address) const { return true; }
+    Address offset() const {
+	return mem_regions.empty() ? 0 : mem_regions.front()->start;
+    }
+    Address length() const {
+	return mem_regions.empty() ? 0 : mem_regions.back()->high() - offset();
+    }
+    Architecture getArch() const { return Arch_x86_64; }
+};
+
+#define JITDUMP_MAGIC      0x4A695444
+#define JITDUMP_MAGIC_SWAP 0x4454694A
+#define JITDUMP_HDR_SIZE   40
+#define JIT_REC_HDR_SIZE   16
+#define JIT_CODE_LOAD      0
+#define JIT_CODE_MOVE      1
+
+template <typename T>
+static T
+readField(const char * ptr)
+{
+    T val;
+    memcpy(&val, ptr, sizeof(T));
+    return val;
+}
+
+// Read the JIT_CODE_LOAD records (and apply JIT_CODE_MOVE) from a
+// perf jitdump file.  The code bytes stay in the file mapping.  If
+// the JIT reused an address range, the most recent load wins.
+//
+static void
+readJitdump(const char * filename, vector <MemRegion *> & regions)
+{
+    size_t len = 0;
+    const char * buf = (const char *) prefetchFile(filename, len);
+
+    if (buf == NULL || len < JITDUMP_HDR_SIZE) {
+	errx(1, "unable to read jitdump file: %s", filename);
+    }
+
+    uint32_t magic = readField <uint32_t> (buf);
+    if (magic == JITDUMP_MAGIC_SWAP) {
+	errx(1, "jitdump file is byte swapped (other endian): %s", filename);
+    }
+    if (magic != JITDUMP_MAGIC) {
+	errx(1, "not a jitdump file: %s", filename);
+    }
+
+    vector <MemRegion *> loads;
+    map <uint64_t, long> indexMap;
+    long num_moves = 0;
+    size_t pos = readField <uint32_t> (buf + 8);
+
+    if (pos < JITDUMP_HDR_SIZE) {
+	pos = JITDUMP_HDR_SIZE;
+    }
+
+    while (pos + JIT_REC_HDR_SIZE <= len) {
+	uint32_t id = readField <uint32_t> (buf + pos);
+	uint32_t size = readField <uint32_t> (buf + pos + 4);
+
+	if (size < JIT_REC_HDR_SIZE || pos + size > len) {
+	    warnx("truncated jitdump record at offset 0x%lx", (long) pos);
+	    break;
+	}
+	const char * rec = buf + pos + JIT_REC_HDR_SIZE;
+	const char * rec_end = buf + pos + size;
+
+	// pid, tid, vma, code_addr, code_size, code_index, name, code
+	if (id == JIT_CODE_LOAD && rec + 40 < rec_end) {
+	    uint64_t code_addr = readField <uint64_t> (rec + 16);
+	    uint64_t code_size = readField <uint64_t> (rec + 24);
+	    uint64_t code_index = readField <uint64_t> (rec + 32);
+	    const char * name = rec + 40;
+	    size_t name_len = strnlen(name, rec_end - name);
+
+	    if (code_size > 0 && name + name_len + 1 + code_size <= rec_end) {
+		indexMap[code_index] = loads.size();
+		loads.push_back(new MemRegion(code_addr, code_size,
+			(const unsigned char *) (name + name_len + 1), string(name, name_len)));
+	    }
+	}
+	// pid, tid, vma, old_code_addr, new_code_addr, code_size, code_index
+	else if (id == JIT_CODE_MOVE && rec + 48 <= rec_end) {
+	    auto it = indexMap.find(readField <uint64_t> (rec + 40));
+	    if (it != indexMap.end()) {
+		loads[it->second]->start = readField <uint64_t> (rec + 24);
+		num_moves++;
+	    }
+	}
+	pos += size;
+    }
+
+    // stable sort keeps load order within the same start address
+    vector <MemRegion *> sorted(loads);
+    std::stable_sort(sorted.begin(), sorted.end(), MemRegionLessThan);
+
+    map <MemRegion *, long> loadOrder;
+    for (long n = 0; n < (long) loads.size(); n++) {
+	loadOrder[loads[n]] = n;
+    }
+
+    long num_replaced = 0;
+    for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+	if (! regions.empty() && (*it)->start < regions.back()->high()) {
+	    if (loadOrder[*it] > loadOrder[regions.back()]) {
+		regions.back() = *it;
+	    }
+	    num_replaced++;
+	    continue;
+	}
+	regions.push_back(*it);
+    }
+
+    printf("jitdump: %ld code loads  moves: %ld  replaced: %ld\n",
+	   (long) loads.size(), num_moves, num_replaced);
+}
+
+// Map each file@base pair as one raw code region at base.
+static void
+readBlobs(const char * spec, vector <MemRegion *> & regions)
+{
+    string str(spec);
+    size_t pos = 0;
+
+    while (pos < str.size()) {
+	size_t comma = str.find(',', pos);
+	if (comma == string::npos) {
+	    comma = str.size();
+	}
+	string pair = str.substr(pos, comma - pos);
+	size_t at = pair.rfind('@');
+
+	if (at == string::npos || at == 0) {
+	    errx(1, "bad blob spec (want file@base): %s", pair.c_str());
+	}
+	string file = pair.substr(0, at);
+	char * end = NULL;
+	Address base = strtoul(pair.c_str() + at + 1, &end, 0);
+
+	if (end == NULL || *end != 0) {
+	    errx(1, "bad base address in blob spec: %s", pair.c_str());
+	}
+
+	size_t len = 0;
+	void * buf = prefetchFile(file.c_str(), len);
+	if (buf == NULL) {
+	    errx(1, "unable to read blob file: %s", file.c_str());
+	}
+	regions.push_back(new MemRegion(base, len, (const unsigned char *) buf, file));
+	pos = comma + 1;
+    }
+
+    std::sort(regions.begin(), regions.end(), MemRegionLessThan);
+
+    for (long n = 1; n < (long) regions.size(); n++) {
+	if (regions[n]->start < regions[n - 1]->high()) {
+	    errx(1, "blobs overlap: %s and %s", regions[n - 1]->name.c_str(),
+		 regions[n]->name.c_str());
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+
+// File offset ranges (--offsets).
+//
+// With --maps, each file is only partly mapped, so the results are
+// restricted to the mapped file offsets.  The offsets are translated
+// to addresses through the code regions, and phases 2 and 3 only
+// check the functions with entry addresses inside the ranges.
+//
+// Parse "lo-hi,lo-hi,..." where [lo, hi) is a half-open range.
+static void
+parseRanges(const char * spec, RangeList & ranges)
+{
+    const char * ptr = spec;
+
+    while (*ptr != 0) {
+	char * end = NULL;
+	Address lo = strtoul(ptr, &end, 0);
+
+	if (end == ptr || *end != '-') {
+	    errx(1, "bad offset range: %s", spec);
+	}
+	ptr = end + 1;
+	Address hi = strtoul(ptr, &end, 0);
+
+	if (end == ptr || (*end != 0 && *end != ',') || hi < lo) {
+	    errx(1, "bad offset range: %s", spec);
+	}
+	if (hi > lo) {
+	    ranges.push_back(make_pair(lo, hi));
+	}
+	ptr = (*end == ',') ? end + 1 : end;
+    }
+    mergeRanges(ranges);
+}
+
+// Intersect the file offset ranges with each code region's file
+// extent and translate to memory addresses.
+static void
+offsetsToAddrs(vector <Region *> & codeRegions, RangeList & offRanges,
+	       RangeList & addrRanges)
+{
+    for (auto rit = codeRegions.begin(); rit != codeRegions.end(); ++rit) {
+	Region * reg = *rit;
+	Address disk_lo = reg->getDiskOffset();
+	Address disk_hi = disk_lo + reg->getDiskSize();
+
+	for (auto it = offRanges.begin(); it != offRanges.end(); ++it) {
+	    Address lo = std::max(it->first, disk_lo);
+	    Address hi = std::min(it->second, disk_hi);
+
+	    if (lo < hi) {
+		addrRanges.push_back(make_pair(reg->getMemOffset() + (lo - disk_lo),
+					       reg->getMemOffset() + (hi - disk_lo)));
+	    }
+	}
+    }
+    mergeRanges(addrRanges);
+}
+
+//----------------------------------------------------------------------
+
+// objdump oracle (--objdump).
+//
+// Read the output of 'objdump -dw' from a file or a pipe ('-' for
+// stdin) and use it as a third opinion on the instruction lengths.
+// The input is read in large chunks, each chunk is split at line
+// boundaries into one piece per thread, and the pieces are parsed in
+// parallel into (address, length) records.  We only need the length
+// from the listing, the bytes come from the binary.  Then merge the
+// sorted records against the sorted phase 2 boundaries and classify
+// each disagreement by who is the odd one out.
+//
+#define OBJDUMP_CHUNK_SIZE  (64 * 1024 * 1024)
+
+class ObjdumpInsn {
+public:
+    Address  addr;
+    uint8_t  len;
+
+    bool operator < (const ObjdumpInsn & other) const {
+	return addr < other.addr;
+    }
+};
+
+static inline int
+hexValue(char ch)
+{
+    if (ch >= '0' && ch <= '9') { return ch - '0'; }
+    if (ch >= 'a' && ch <= 'f') { return ch - 'a' + 10; }
+    if (ch >= 'A' && ch <= 'F') { return ch - 'A' + 10; }
+    return -1;
+}
+
+// Parse the instruction lines in [ptr, end), which is whole lines.
+//   "  4012a0:\t48 89 e5             \tmov    %rsp,%rbp"
+// Function labels, section headers and blank lines don't match.
+static void
+parseObjdumpPiece(const char * ptr, const char * end, vector <ObjdumpInsn> & insns)
+{
+    while (ptr < end) {
+	const char * eol = (const char *) memchr(ptr, '\n', end - ptr);
+	if (eol == NULL) {
+	    eol = end;
+	}
+
+	const char * p = ptr;
+	Address addr = 0;
+	int digits = 0;
+
+	while (p < eol && *p == ' ') {
+	    p++;
+	}
+	while (p < eol && hexValue(*p) >= 0) {
+	    addr = (addr << 4) | hexValue(*p);
+	    digits++;
+	    p++;
+	}
+
+	if (digits > 0 && p + 1 < eol && p[0] == ':' && p[1] == '\t') {
+	    int len = 0;
+
+	    p += 2;
+	    while (p + 1 < eol && *p != '\t') {
+		if (*p == ' ') {
+		    p++;
+		}
+		else if (hexValue(p[0]) >= 0 && hexValue(p[1]) >= 0) {
+		    len++;
+		    p += 2;
+		}
+		else {
+		    break;
+		}
+	    }
+	    if (len > 0) {
+		ObjdumpInsn insn;
+		insn.addr = addr;
+		insn.len = len;
+		insns.push_back(insn);
+	    }
+	}
+	ptr = eol + 1;
+    }
+}
+
+// Parse one chunk of whole lines in parallel.
+static void
+parseObjdumpChunk(const char * buf, size_t size, vector <ObjdumpInsn> & insns)
+{
+    int nthreads = std::max(opts.check_jobs, 1);
+    vector <const char *> cuts(nthreads + 1);
+    vector <vector <ObjdumpInsn>> pieces(nthreads);
+
+    cuts[0] = buf;
+    for (int t = 1; t < nthreads; t++) {
+	const char * cut = buf + t * (size / nthreads);
+	const char * nl = (const char *) memchr(cut, '\n', buf + size - cut);
+
+	cut = (nl != NULL) ? nl + 1 : buf + size;
+	cuts[t] = std::max(cut, cuts[t - 1]);
+    }
+    cuts[nthreads] = buf + size;
+
+#pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+    for (int t = 0; t < nthreads; t++) {
+	parseObjdumpPiece(cuts[t], cuts[t + 1], pieces[t]);
+    }
+
+    for (int t = 0; t < nthreads; t++) {
+	insns.insert(insns.end(), pieces[t].begin(), pieces[t].end());
+    }
+}
+
+// Read the listing in chunks, keeping any partial last line for the
+// next chunk, so that a pipe from objdump works the same as a file.
+static void
+readObjdump(const char * path, vector <ObjdumpInsn> & insns)
+{
+    bool is_stdin = (strcmp(path, "-") == 0);
+    int fd = is_stdin ? 0 : open(path, O_RDONLY);
+
+    if (fd < 0) {
+	err(1, "unable to open objdump file: %s", path);
+    }
+
+    vector <char> buf(OBJDUMP_CHUNK_SIZE);
+    size_t used = 0;
+
+    for (;;) {
+	ssize_t ret = read(fd, buf.data() + used, buf.size() - used);
+
+	if (ret < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    err(1, "read failed: %s", path);
+	}
+	used += ret;
+	ctx->objdump_bytes += ret;
+
+	if (ret > 0 && used < buf.size()) {
+	    continue;
+	}
+
+	// parse up to the last newline, or everything at eof
+	size_t len = used;
+	if (ret > 0) {
+	    const char * nl = (const char *) memrchr(buf.data(), '\n', used);
+	    if (nl == NULL) {
+		buf.resize(2 * buf.size());
+		continue;
+	    }
+	    len = nl - buf.data() + 1;
+	}
+	parseObjdumpChunk(buf.data(), len, insns);
+
+	memmove(buf.data(), buf.data() + len, used - len);
+	used -= len;
+
+	if (ret == 0) {
+	    break;
+	}
+    }
+    if (! is_stdin) {
+	close(fd);
+    }
+
+    if (! std::is_sorted(insns.begin(), insns.end())) {
+	std::sort(insns.begin(), insns.end());
+    }
+}
+
+static void
+compareObjdump(vector <InsnBound> & bounds)
+{
+    vector <ObjdumpInsn> insns;
+    double start = omp_get_wtime();
+
+    readObjdump(opts.objdump, insns);
+    ctx->objdump_num_insns = insns.size();
+
+    std::sort(bounds.begin(), bounds.end());
+
+    long j = 0;
+    for (auto it = bounds.begin(); it != bounds.end(); ++it) {
+	while (j < (long) insns.size() && insns[j].addr < it->addr) {
+	    j++;
+	}
+	if (j >= (long) insns.size() || insns[j].addr != it->addr) {
+	    ctx->objdump_missing++;
+	    continue;
+	}
+	ctx->objdump_matched++;
+
+	int dyn = it->dyn_len;
+	int xed = it->xed_len;
+	int obj = insns[j].len;
+	const char * who = NULL;
+
+	if (dyn == xed && xed == obj) {
+	    ctx->objdump_agree++;
+	    continue;
+	}
+	else if (xed == obj) {
+	    ctx->objdump_dyn_wrong++;
+	    who = "dyninst";
+	}
+	else if (dyn == obj) {
+	    ctx->objdump_xed_wrong++;
+	    who = "xed";
+	}
+	else if (dyn == xed) {
+	    ctx->objdump_differs++;
+	    who = "objdump";
+	}
+	else {
+	    ctx->objdump_all_differ++;
+	    who = "all differ";
+	}
+	if (! opts.quiet) {
+	    printf("3-way at 0x%lx:  dyn: %d  xed: %d  objdump: %d  (%s)\n",
+		   it->addr, dyn, xed, obj, who);
+	}
+    }
+    ctx->objdump_secs = omp_get_wtime() - start;
+}
+
+//----------------------------------------------------------------------
+
+// Instruction boundary oracle (--boundaries).
 //
-// If Dyninst doesn't recognize an op code, it should show up as (1).
-// If it thinks it does but gets it wrong, it will show up as (2) or (3).
+// Two free, decoder-independent checks on dyninst's instruction
+// boundaries: every line table row address must be the start of an
+// instruction, and every relocation in a code region must be inside
+// an instruction (at a fixed offset in its displacement or
+// immediate), never at the start and never across the end.  Collect
+// both into sorted arrays and merge each once against the sorted
+// phase 2 boundaries.
 //
-#define MY_BUF_SIZE (XED_MAX_INSTRUCTION_BYTES + 4)
+#define R_X86_64_64_TYPE  1
 
-static int num_xed_errors = 0;
-
-InstructionAPI::Instruction
-myXedCallback(InstructionDecoder::buffer seqn)
+// Return the index of the last boundary at or before addr, starting
+// the search at j (the queries are sorted), or -1 if none.
+static long
+lastBoundBefore(const vector <InsnBound> & bounds, Address addr, long & j)
 {
-    uint8_t buf[MY_BUF_SIZE];
-    Instruction ret;
+    while (j < (long) bounds.size() && bounds[j].addr <= addr) {
+	j++;
+    }
+    return j - 1;
+}
 
-    // copy into array of uint8_t for xed
-    int buf_len = 0;
-    for (auto p = seqn.start; p != seqn.end; ++p) {
-	buf[buf_len] = (uint8_t) *p;
-	buf_len++;
+static void
+checkBoundaries(vector <InsnBound> & bounds)
+{
+    vector <Address> lines;
+    vector <pair <Address, int>> relocs;
 
-	if (buf_len >= MY_BUF_SIZE) {
-	    break;
-	}
+    if (! std::is_sorted(bounds.begin(), bounds.end())) {
+	std::sort(bounds.begin(), bounds.end());
     }
 
-    xed_decoded_inst_t xedd;
-    xed_state_t dstate;
-    unsigned int xed_len = 0;
-    unsigned int start = 0;
-    bool is_valid = false, is_troll = false;
-
-    // test beginning of buffer
-    xed_state_zero(&dstate);
-    dstate.mmode = XED_MACHINE_MODE_LONG_64;
-    xed_decoded_inst_zero_set_mode(&xedd, &dstate);
-    int xed_error = xed_decode(&xedd, buf, buf_len);
-
-    if (xed_error == XED_ERROR_NONE) {
-	//
-	// case 1 - valid instruction at beginning of buffer
-	// return a dyninst fake no-op, all we care about is the length,
-	// since we don't expect any control flow here
-	//
-	xed_len = xed_decoded_inst_get_length(&xedd);
-	is_valid = true;
-	if (opts.fix_valid) {
-	    ret = Instruction {
-		{ e_nop, "nop", Arch_x86_64 },
-		xed_len,
-		seqn.start,
-		Arch_x86_64
-	    };
-	} else {
-	    ret = Instruction{};
-	}
-    }
-    else {
-	// try trolling
-	for (start = 1; start < buf_len; start++) {
-	    xed_state_zero(&dstate);
-	    dstate.mmode = XED_MACHINE_MODE_LONG_64;
-	    xed_decoded_inst_zero_set_mode(&xedd, &dstate);
-	    xed_error = xed_decode(&xedd, buf + start, buf_len - start);
-
-	    if (xed_error == XED_ERROR_NONE) {
-		//
-		// case 2 -- out of sync instn starting at buf[start].
-		// return fake no-op and let dyninst get back in sync
-		//
-		xed_len = xed_decoded_inst_get_length(&xedd);
-		is_troll = true;
-		if (opts.fix_troll) {
-		    ret = Instruction {
-			{ e_nop, "nop", Arch_x86_64 },
-			start,
-			seqn.start,
-			Arch_x86_64
-		    };
-		} else {
-		    ret = Instruction{};
-		}
-		break;
+    // line table row addresses
+    vector <Module *> modules;
+    ctx->symtab->getAllModules(modules);
+
+    for (auto mit = modules.begin(); mit != modules.end(); ++mit) {
+	LineInformation * info = (*mit)->parseLineInformation();
+
+	if (info != NULL) {
+	    for (auto it = info->begin(); it != info->end(); ++it) {
+		lines.push_back((*it)->startAddr());
 	    }
 	}
-	if (xed_error != XED_ERROR_NONE) {
-	    //
-	    // case 3 -- not a valid instruction, trolling failed
-	    // return an invalid instruction
-	    //
-	    ret = Instruction{};
-	}
     }
+    std::sort(lines.begin(), lines.end());
+    lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+    ctx->bound_num_lines = lines.size();
 
-    // sometime fixing trolls is dangerous, don't allow an infinite
-    // string of errors
-    if (xed_error != XED_ERROR_NONE) {
-	num_xed_errors++;
+    // relocations in the code regions and their field size
+    vector <Region *> codeRegions;
+    ctx->symtab->getCodeRegions(codeRegions);
 
-	if (num_xed_errors > 20) {
-	    cout << "\nexceeded num xed errors: " << num_xed_errors << "\n" << endl;
-	    exit(1);
+    for (auto rit = codeRegions.begin(); rit != codeRegions.end(); ++rit) {
+	vector <relocationEntry> & rels = (*rit)->getRelocations();
+
+	for (auto it = rels.begin(); it != rels.end(); ++it) {
+	    int size = (it->getRelType() == R_X86_64_64_TYPE) ? 8 : 4;
+	    relocs.push_back(make_pair(it->rel_addr(), size));
 	}
     }
-    else {
-	num_xed_errors = 0;
-    }
+    std::sort(relocs.begin(), relocs.end());
+    ctx->bound_num_relocs = relocs.size();
+
+    long j = 0;
+    for (auto it = lines.begin(); it != lines.end(); ++it) {
+	long k = lastBoundBefore(bounds, *it, j);
 
-    // serialize the output to allow for multiple threads
-    // we could sprintf() to a buffer and then dump all at once
-    print_mutex.lock();
+	if (k < 0 || *it >= bounds[k].addr + bounds[k].dyn_len) {
+	    continue;
+	}
+	ctx->bound_lines_checked++;
+	if (bounds[k].addr != *it) {
+	    ctx->bound_lines_bad++;
+	    if (! opts.quiet) {
+		printf("line mid-instn: 0x%lx  instn: 0x%lx  len: %d\n",
+		       *it, bounds[k].addr, bounds[k].dyn_len);
+	    }
+	}
+    }
 
-    // only count and report errors on initial parse.  splitting a
-    // block into instructions causes duplicate calls here.
-    if (initial_parse && ! opts.quiet) {
-	printf("unknown: ");
+    j = 0;
+    for (auto it = relocs.begin(); it != relocs.end(); ++it) {
+	Address addr = it->first;
+	long k = lastBoundBefore(bounds, addr, j);
 
-	for (int i = 0; i < buf_len; i++) {
-	    printf(" %02x", buf[i]);
+	if (k < 0 || addr >= bounds[k].addr + bounds[k].dyn_len) {
+	    continue;
 	}
-	if (is_valid) {
-	    printf("  valid: %d%s\n", xed_len,
-		   opts.fix_valid ? "  (fix)" : "");
+	ctx->bound_relocs_checked++;
+
+	Address end = bounds[k].addr + bounds[k].dyn_len;
+	const char * what = NULL;
 
+	if (addr == bounds[k].addr) {
+	    what = "at instn start";
 	}
-	else if (is_troll) {
-	    printf("  troll: %d  len: %d%s\n", start, xed_len,
-		   opts.fix_troll ? "  (fix)" : "");
+	else if (addr + it->second > end) {
+	    what = "crosses instn end";
 	}
-	else {
-	    printf("  error\n");
+	if (what != NULL) {
+	    ctx->bound_relocs_bad++;
+	    if (! opts.quiet) {
+		printf("reloc %s: 0x%lx  size: %d  instn: 0x%lx  len: %d\n",
+		       what, addr, it->second, bounds[k].addr, bounds[k].dyn_len);
+	    }
 	}
     }
-
-    if (initial_parse) {
-	num_unknown++;
-	if (is_valid) { num_unknown_valid++; }
-	else if (is_troll) { num_unknown_troll++; }
-	else { num_unknown_error++; }
-    }
-
-    print_mutex.unlock();
-
-    return ret;
 }
 
 //----------------------------------------------------------------------
 
-// Iterate the instructions in a block and compare the length of each
-// instruction with xed's length.  Also, make sure there are no gaps
-// between instructions (rarely happens, but dyninst error if it does).
+// Function ranges from .eh_frame (--eh-frame).
 //
-// Note: we only report one error per block.  After that, we consider
-// the block to be corrupted and not worth testing any further.
+// Stripped libraries have few symbols, so parseFunctionRanges() finds
+// few entry points, and dyninst falls back on slow gap parsing.  But
+// almost every function has an FDE in .eh_frame with its start and
+// length.  Walk .eh_frame once (the FDEs already have the ranges, so
+// we don't need the .eh_frame_hdr search table) and add a symtab
+// function for each FDE start that doesn't have one.  Then parse()
+// starts from all of them in parallel.  After parsing, merge the
+// sorted FDE ranges against the sorted blocks to measure coverage.
 //
-void
-doBlock(Block * block)
-{
-    Address block_start = block->start();
-    long block_size = block->size();
-    num_bytes += block_size;
-
-    //
-    // step 1 -- malloc buffer for entire block plus one instruction
-    // in case xed length is longer than dyninst length.
-    //
-    long buf_size = block_size + 20;
-    uint8_t * buf = (uint8_t *) malloc(buf_size);
-
-    if (buf == NULL) {
-	err(1, "malloc buffer in doBlock failed, size: %ld", buf_size);
-    }
-    memset(buf, 0, buf_size);
-
-    //
-    // step 2 -- iterate instructions and fill in buffer,
-    // check instructions are all adjacent.
-    //
-    Block::Insns imap;
-    block->getInsns(imap);
-    num_instns += imap.size();
-
-    long pos = 0;
-    for (auto iit = imap.begin(); iit != imap.end(); ++iit) {
-	Address addr = iit->first;
-	Offset dyn_len = iit->second.size();
-
-	if (block_start + pos != addr) {
-	    if (! opts.quiet) {
-		printf("block error (align): 0x%lx  offset: 0x%lx  next: 0x%lx\n",
-		       block_start, pos, addr);
+#define DW_EH_PE_omit     0xff
+#define DW_EH_PE_absptr   0x00
+#define DW_EH_PE_uleb128  0x01
+#define DW_EH_PE_udata2   0x02
+#define DW_EH_PE_udata4   0x03
+#define DW_EH_PE_udata8   0x04
+#define DW_EH_PE_sleb128  0x09
+#define DW_EH_PE_sdata2   0x0a
+#define DW_EH_PE_sdata4   0x0b
+#define DW_EH_PE_sdata8   0x0c
+#define DW_EH_PE_pcrel    0x10
+
+class EhReader {
+public:
+    const unsigned char *  data;
+    size_t  size;
+    size_t  pos;
+    Address  base;
+    bool  error;
+
+    EhReader(const unsigned char * d, size_t sz, Address b)
+	: data(d), size(sz), pos(0), base(b), error(false) { }
+
+    uint64_t bytes(int len) {
+	uint64_t val = 0;
+	if (pos + len > size) {
+	    error = true;
+	    pos = size;
+	    return 0;
+	}
+	memcpy(&val, data + pos, len);
+	pos += len;
+	return val;
+    }
+
+    uint64_t uleb() {
+	uint64_t val = 0;
+	int shift = 0;
+	while (pos < size) {
+	    unsigned char byte = data[pos++];
+	    val |= (uint64_t) (byte & 0x7f) << shift;
+	    shift += 7;
+	    if ((byte & 0x80) == 0) {
+		return val;
 	    }
-	    num_block_align_errors++;
-	    goto end_block;
 	}
-	if (pos + dyn_len > block_size) {
-	    if (! opts.quiet) {
-		printf("block error (too long): 0x%lx  offset: 0x%lx  size: 0x%lx  len: 0x%lx\n",
-		       block_start, pos, dyn_len, block_size);
+	error = true;
+	return val;
+    }
+
+    int64_t sleb() {
+	int64_t val = 0;
+	int shift = 0;
+	while (pos < size) {
+	    unsigned char byte = data[pos++];
+	    val |= (int64_t) (byte & 0x7f) << shift;
+	    shift += 7;
+	    if ((byte & 0x80) == 0) {
+		if (shift < 64 && (byte & 0x40)) {
+		    val |= - ((int64_t) 1 << shift);
+		}
+		return val;
 	    }
-	    num_block_length_errors++;
-	    goto end_block;
 	}
+	error = true;
+	return val;
+    }
 
-	for (int n = 0; n < dyn_len; n++) {
-	    buf[pos + n] = (uint8_t) iit->second.rawByte(n);
+    // read a pointer with a DW_EH_PE encoding, only absolute and pc
+    // relative are used in .eh_frame on x86_64
+    uint64_t pointer(int enc) {
+	Address field = base + pos;
+	uint64_t val = 0;
+
+	switch (enc & 0x0f) {
+	case DW_EH_PE_absptr:  val = bytes(8);  break;
+	case DW_EH_PE_uleb128: val = uleb();  break;
+	case DW_EH_PE_udata2:  val = (uint16_t) bytes(2);  break;
+	case DW_EH_PE_udata4:  val = (uint32_t) bytes(4);  break;
+	case DW_EH_PE_udata8:  val = bytes(8);  break;
+	case DW_EH_PE_sleb128: val = sleb();  break;
+	case DW_EH_PE_sdata2:  val = (int16_t) bytes(2);  break;
+	case DW_EH_PE_sdata4:  val = (int32_t) bytes(4);  break;
+	case DW_EH_PE_sdata8:  val = bytes(8);  break;
+	default:
+	    error = true;
+	    return 0;
+	}
+	if ((enc & 0x70) == DW_EH_PE_pcrel) {
+	    val += field;
 	}
-	pos += dyn_len;
+	return val;
     }
+};
 
-    //
-    // step 3 -- iterate instructions and compare length with xed
-    //
-    for (auto iit = imap.begin(); iit != imap.end(); ++iit) {
-	Address addr = iit->first;
-	Offset dyn_len = iit->second.size();
-	xed_decoded_inst_t xedd;
-	xed_state_t dstate;
+// Return the FDE pointer encoding from the CIE at offset, or -1 on
+// error.  Only the augmentation data is needed.
+static int
+readCieEncoding(const unsigned char * data, size_t size, Address base, size_t offset)
+{
+    EhReader rd(data, size, base);
+    rd.pos = offset;
 
-	xed_state_zero(&dstate);
-	dstate.mmode = XED_MACHINE_MODE_LONG_64;
-	xed_decoded_inst_zero_set_mode(&xedd, &dstate);
-	int xed_error = xed_decode(&xedd, &buf[addr - block_start], 16);
+    uint64_t length = rd.bytes(4);
+    if (length == 0xffffffff) {
+	rd.bytes(8);
+    }
+    if (rd.bytes(4) != 0) {
+	return -1;
+    }
+    int version = rd.bytes(1);
+    string aug((const char *) data + rd.pos, strnlen((const char *) data + rd.pos, size - rd.pos));
+    rd.pos += aug.size() + 1;
 
-	long xed_len =
-	    (xed_error == XED_ERROR_NONE) ? xed_decoded_inst_get_length(&xedd) : 0;
+    if (aug.find("eh") != string::npos) {
+	rd.bytes(8);
+    }
+    rd.uleb();
+    rd.sleb();
+    if (version == 1) {
+	rd.bytes(1);
+    }
+    else {
+	rd.uleb();
+    }
 
-	if (xed_error != XED_ERROR_NONE || dyn_len != xed_len) {
-	    if (! opts.quiet) {
-		printf("bad length at 0x%lx: ", addr);
-		for (int i = 0; i < 16; i++) {
-		    printf(" %02x", buf[addr - block_start + i]);
-		}
-		printf("  dyn: %ld  xed: %ld\n", dyn_len, xed_len);
+    int enc = DW_EH_PE_absptr;
+    if (! aug.empty() && aug[0] == 'z') {
+	rd.uleb();
+	for (size_t n = 1; n < aug.size() && ! rd.error; n++) {
+	    if (aug[n] == 'R') {
+		enc = rd.bytes(1);
+	    }
+	    else if (aug[n] == 'L') {
+		rd.bytes(1);
+	    }
+	    else if (aug[n] == 'P') {
+		int penc = rd.bytes(1);
+		rd.pointer(penc & 0x7f);
+	    }
+	    else if (aug[n] != 'S' && aug[n] != 'B') {
+		break;
 	    }
-	    num_bad_length++;
-	    goto end_block;
 	}
     }
+    return rd.error ? -1 : enc;
+}
+
+// Walk .eh_frame and collect the FDE ranges [start, end), sorted.
+static void
+readEhFrame(const unsigned char * data, size_t size, Address base, RangeList & ranges)
+{
+    map <size_t, int> cieEnc;
+    EhReader rd(data, size, base);
+
+    while (rd.pos + 4 <= size) {
+	uint64_t length = rd.bytes(4);
+
+	if (length == 0) {
+	    break;
+	}
+	if (length == 0xffffffff) {
+	    length = rd.bytes(8);
+	}
+	size_t id_pos = rd.pos;
+	size_t next = id_pos + length;
+	if (rd.error || next > size) {
+	    break;
+	}
 
- end_block:
-    free(buf);
+	uint32_t cie_id = rd.bytes(4);
+	if (cie_id != 0) {
+	    size_t cie = id_pos - cie_id;
+	    auto it = cieEnc.find(cie);
+	    if (it == cieEnc.end()) {
+		it = cieEnc.insert(make_pair(cie, readCieEncoding(data, size, base, cie))).first;
+	    }
+	    int enc = it->second;
+
+	    if (enc >= 0 && enc != DW_EH_PE_omit) {
+		Address lo = rd.pointer(enc);
+		Address len = rd.pointer(enc & 0x0f);
 
-    return;
+		if (! rd.error && len > 0) {
+		    ranges.push_back(make_pair(lo, lo + len));
+		}
+	    }
+	}
+	rd.error = false;
+	rd.pos = next;
+    }
+    std::sort(ranges.begin(), ranges.end());
 }
 
-//----------------------------------------------------------------------
+// Read the FDE ranges and add a symtab function at each FDE start
+// that doesn't already have one.
+static void
+seedFromEhFrame(Symtab * symtab)
+{
+    Region * reg = NULL;
+    double start = omp_get_wtime();
 
-void
-doFunction(ParseAPI::Function * func)
+    if (! symtab->findRegion(reg, ".eh_frame") || reg == NULL
+	|| reg->getPtrToRawData() == NULL) {
+	warnx("no .eh_frame section: %s", ctx->filename);
+	return;
+    }
+    readEhFrame((const unsigned char *) reg->getPtrToRawData(), reg->getDiskSize(),
+		reg->getMemOffset(), ctx->fde_ranges);
+
+    for (auto it = ctx->fde_ranges.begin(); it != ctx->fde_ranges.end(); ++it) {
+	SymtabAPI::Function * func = NULL;
+
+	if (symtab->findFuncByEntryOffset(func, it->first) && func != NULL) {
+	    continue;
+	}
+	char name[100];
+	snprintf(name, sizeof(name), "fde_%lx", it->first);
+
+	if (symtab->createFunction(name, it->first, it->second - it->first) != NULL) {
+	    ctx->num_fde_seeded++;
+	}
+    }
+    ctx->eh_secs = omp_get_wtime() - start;
+}
+
+// Merge the sorted FDE ranges against the sorted blocks and count the
+// FDE bytes covered by some block, and FDEs with no blocks at all.
+static void
+compareEhFrame(const CodeObject::funclist & funcList)
 {
-    // get map of visited blocks and convert to vector
-    const ParseAPI::Function::blocklist & blist = func->blocks();
-    vector <Block *> blockVec;
+    RangeList blocks;
+
+    for (auto fit = funcList.begin(); fit != funcList.end(); ++fit) {
+	const ParseAPI::Function::blocklist & blist = (*fit)->blocks();
 
-    for (auto bit = blist.begin(); bit != blist.end(); ++bit) {
-	Block * block = *bit;
-	blockVec.push_back(block);
+	for (auto bit = blist.begin(); bit != blist.end(); ++bit) {
+	    blocks.push_back(make_pair((*bit)->start(), (*bit)->end()));
+	}
     }
-    num_blocks += blockVec.size();
+    mergeRanges(blocks);
 
-    // sort by block start address
-    std::sort(blockVec.begin(), blockVec.end(), BlockLessThan);
+    long j = 0;
+    for (auto it = ctx->fde_ranges.begin(); it != ctx->fde_ranges.end(); ++it) {
+	long covered = 0;
+
+	while (j < (long) blocks.size() && blocks[j].second <= it->first) {
+	    j++;
+	}
+	for (long k = j; k < (long) blocks.size() && blocks[k].first < it->second; k++) {
+	    covered += std::min(blocks[k].second, it->second)
+		- std::max(blocks[k].first, it->first);
+	}
 
-    for (long n = 0; n < blockVec.size(); n++) {
-	Block * block = blockVec[n];
-	doBlock(block);
+	ctx->fde_bytes += it->second - it->first;
+	ctx->fde_covered += covered;
+	if (covered == 0) {
+	    ctx->num_fde_missed++;
+	    if (! opts.quiet) {
+		printf("fde missed: 0x%lx  end: 0x%lx  size: 0x%lx\n",
+		       it->first, it->second, it->second - it->first);
+	    }
+	}
     }
 }
 
 //----------------------------------------------------------------------
 
-// Search for unclaimed regions (gaps) between basic blocks.  Some
-// compilers insert cold regions inside other functions, so we need to
-// analyze all blocks together.
+// Analyze one file, an.filename, all three phases and summary.
+// The analysis is ctx for this thread until the end.
 //
-void
-doGaps(vector <ParseAPI::Function *> & funcVec)
+int
+analyzeFile(Analysis & an)
 {
-    // get list of all blocks and sort by start address
-    vector <Block *> blockVec;
+    ctx = &an;
 
-    for (auto fit = funcVec.begin(); fit != funcVec.end(); ++fit) {
-	ParseAPI::Function * func = *fit;
-	const ParseAPI::Function::blocklist & blist = func->blocks();
+    const char * nl = (! opts.quiet) ? "\n" : "";
 
-	for (auto bit = blist.begin(); bit != blist.end(); ++bit) {
-	    Block * block = *bit;
-	    blockVec.push_back(block);
+    cout << "\nreading file: " << ctx->filename << " ..." << endl;
+
+    double read_start = omp_get_wtime();
+    PROBE2(phase__start, "read", ctx->filename);
+
+    vector <MemRegion *> memRegions;
+
+    if (opts.input == INPUT_JITDUMP) {
+	readJitdump(ctx->filename, memRegions);
+    }
+    else if (opts.input == INPUT_BLOB) {
+	readBlobs(ctx->filename, memRegions);
+    }
+    else if (ctx->mem_image != NULL) {
+	if (! Symtab::openFile(ctx->symtab, ctx->mem_image, ctx->mem_image_size, ctx->filename)) {
+	    errx(1, "Symtab::openFile (in memory) failed: %s", ctx->filename);
+	}
+    }
+    else {
+	if (! Symtab::openFile(ctx->symtab, ctx->filename)) {
+	    errx(1, "Symtab::openFile (on disk) failed: %s", ctx->filename);
 	}
     }
 
-    std::sort(blockVec.begin(), blockVec.end(), BlockLessThan);
+    // whole file code size and function symbols for -j auto and
+    // --jobs-profile
+    double text_bytes = 0.0;
+    long num_syms = 0;
 
-    //
-    // compare adjacent blocks
-    //
-    Block * prev_block = blockVec[0];
+    if (opts.input == INPUT_ELF) {
+	vector <Region *> codeRegions;
+	ctx->symtab->getCodeRegions(codeRegions);
+
+	for (auto rit = codeRegions.begin(); rit != codeRegions.end(); ++rit) {
+	    text_bytes += (*rit)->getDiskSize();
+	}
+	if (opts.jobs_auto || opts.jobs_profile != NULL) {
+	    vector <SymtabAPI::Function *> symFuncs;
+	    ctx->symtab->getAllFunctions(symFuncs);
+	    num_syms = symFuncs.size();
+	}
 
-    for (long n = 1; n < blockVec.size(); n++) {
-	Block * block = blockVec[n];
-	long size = block->start() - prev_block->end();
+	if (ctx->offsets != NULL) {
+	    RangeList offRanges;
 
-	if (size > 0) {
-	    if (! opts.quiet) {
-		cout << "gap: prev block: 0x" << hex << prev_block->start()
-		     << "  end: 0x" << prev_block->end()
-		     << "  next: 0x" << block->start()
-		     << "  size: 0x" << size
-		     << dec << " (" << size << ")\n";
-	    }
-	    num_gaps++;
-	    size_gaps += size;
+	    parseRanges(ctx->offsets, offRanges);
+	    offsetsToAddrs(codeRegions, offRanges, ctx->mapped_ranges);
 
-	    if (size < 16) {
-		num_gaps_16++;
-		size_gaps_16 += size;
-	    }
-	    else if (size < 64) {
-		num_gaps_64++;
-		size_gaps_64 += size;
-	    }
-	    else if (size < 256) {
-		num_gaps_256++;
-		size_gaps_256 += size;
-	    }
-	    else {
-		num_gaps_other++;
-		size_gaps_other += size;
+	    for (auto it = ctx->mapped_ranges.begin(); it != ctx->mapped_ranges.end(); ++it) {
+		ctx->code_bytes += it->second - it->first;
 	    }
 	}
-	else if (size < 0) {
-	    //
-	    // overlap or duplicate blocks
-	    //
-	    if (! opts.quiet) {
-		cout << "overlap: prev end: 0x" << hex << prev_block->end()
-		     << "  begin: 0x" << block->start()
-		     << "  end: 0x" << block->end() << dec << "\n";
+	else {
+	    for (auto rit = codeRegions.begin(); rit != codeRegions.end(); ++rit) {
+		ctx->code_bytes += (*rit)->getDiskSize();
 	    }
-	    num_overlap++;
 	}
-
-	prev_block = block;
     }
-}
 
-//----------------------------------------------------------------------
+    for (auto rit = memRegions.begin(); rit != memRegions.end(); ++rit) {
+	ctx->code_bytes += (*rit)->size;
+	text_bytes += (*rit)->size;
+    }
 
-int
-main(int argc, char **argv)
-{
-    getOptions(argc, argv, opts);
+    PROBE3(phase__end, "read", ctx->filename, PROBE_USECS(read_start));
 
-    const char * nl = (! opts.quiet) ? "\n" : "";
+    // this writes opts.jobs, but -j auto is only for one analysis per
+    // process (not --in-process)
+    if (opts.jobs_auto) {
+	chooseJobs(std::max(text_bytes, 1.0), num_syms);
+	ctx->jobs = opts.jobs;
+	ctx->check_jobs = opts.check_jobs;
+    }
 
-    cout << "file: " << opts.filename << "\n"
-	 << "threads: " << opts.jobs
-	 << "  fix valid: " << opts.fix_valid
-	 << "  fix troll: " << opts.fix_troll << endl;
+    // this is only for the dyninst parse() phase.  the openmp thread
+    // count is per thread, restore it for the next file on this thread.
+    int saved_threads = omp_get_max_threads();
+    omp_set_num_threads(ctx->jobs);
 
-    xed_tables_init();
+    // and tbb gets no more threads than our largest openmp team
+    tbb::global_control tbb_limit(tbb::global_control::max_allowed_parallelism,
+				  std::max(ctx->jobs, ctx->check_jobs));
 
-    // this is only for the dyninst parse() phase
-    omp_set_num_threads(opts.jobs);
+    // pin the openmp threads before parse, so the CFG is allocated
+    // on the node of the thread that builds it (first touch)
+    if (opts.numa != NUMA_NONE) {
+	getNumaTopology();
 
-    cout << "\nreading file: " << opts.filename << " ..." << endl;
+#pragma omp parallel
+	pinThread(numaThreadNode(omp_get_thread_num()));
+    }
 
-    if (! Symtab::openFile(the_symtab, opts.filename)) {
-	errx(1, "Symtab::openFile (on disk) failed: %s", opts.filename);
+    if (opts.xed_cache != NULL && ! opts.in_process) {
+	loadXedCache(opts.xed_cache);
     }
+    if (opts.profile != NULL) {
+	readProfile(opts.profile);
+    }
+    ctx->want_findings = opts.source || opts.profile != NULL || opts.verdicts != NULL;
+    ctx->want_bounds = opts.objdump != NULL || opts.boundaries;
 
     // ------------------------------------------------------------
     // Phase 1 -- test for unknown instructions
@@ -647,47 +2599,161 @@ main(int argc, char **argv)
 
     // enable callback
     InstructionDecoder::unknown_instruction::register_callback(&myXedCallback);
-    initial_parse = 1;
 
-    the_symtab->parseTypesNow();
-    the_symtab->parseFunctionRanges();
+    CodeSource * code_src = NULL;
+
+    if (ctx->symtab != NULL) {
+	ctx->symtab->parseTypesNow();
+	ctx->symtab->parseFunctionRanges();
 
-    SymtabCodeSource * code_src = new SymtabCodeSource(the_symtab);
+	if (opts.eh_frame) {
+	    seedFromEhFrame(ctx->symtab);
+	}
+
+	code_src = new SymtabCodeSource(ctx->symtab);
+    }
+    else {
+	code_src = new MemCodeSource(memRegions);
+    }
     CodeObject * code_obj = new CodeObject(code_src);
 
-    code_obj->parse();
+    parseCode(code_obj);
+
+    // the pinning was for the parse (first touch), put the threads
+    // back, or the main thread runs the rest on one node
+    if (opts.numa != NUMA_NONE) {
+#pragma omp parallel
+	unpinThread();
+    }
+
+    printSamples(KIND_UNKNOWN);
+
+    if (opts.eh_frame) {
+	compareEhFrame(code_obj->funcs());
+    }
 
     // ------------------------------------------------------------
     // Phase 2 -- test for "known" instructions with wrong length
     // ------------------------------------------------------------
     cout << nl << "phase 2 -- test known instructions for bad length ..." << nl << endl;
 
-    // we have to keep the callback in place to be consistent for
-    // fixed instructions, but turn off counting unknown instructions
-    initial_parse = 0;
-
-    // put function list into vector and sort by entry address
-    const CodeObject::funclist & funcList = code_obj->funcs();
     vector <ParseAPI::Function *> funcVec;
+    getSortedFuncs(code_obj, funcVec);
 
-    for (auto fit = funcList.begin(); fit != funcList.end(); ++fit) {
-	ParseAPI::Function * func = *fit;
-	funcVec.push_back(func);
+    long num_all_funcs = funcVec.size();
+    vector <ParseAPI::Function *> allFuncs;
+
+    if (ctx->want_findings) {
+	buildBlockIndex(funcVec);
+    }
+    if (opts.verdicts != NULL) {
+	allFuncs = funcVec;
+    }
+
+    if (ctx->offsets != NULL) {
+	funcVec.erase(std::remove_if(funcVec.begin(), funcVec.end(),
+			  [](ParseAPI::Function * func) {
+			      return ! inRanges(ctx->mapped_ranges, func->addr());
+			  }),
+		      funcVec.end());
     }
 
-    std::sort(funcVec.begin(), funcVec.end(), FuncLessThan);
+    if (opts.order_score) {
+	orderByScore(funcVec, code_src);
+    }
+    if (opts.profile != NULL) {
+	orderByProfile(funcVec);
+    }
+
+    // with --clones, check one function of each clone group
+    vector <ParseAPI::Function *> checkVec;
+
+    if (opts.clones) {
+	findClones(funcVec, code_src, checkVec);
+    }
+    else {
+	checkVec = funcVec;
+    }
 
-    for (long n = 0; n < funcVec.size(); n++) {
-	ParseAPI::Function * func = funcVec[n];
-	doFunction(func);
+    // with --fail-fast, phase 1 may already have enough problems
+    double start = omp_get_wtime();
+    double start_cpu = cpuSecs();
+    PROBE2(phase__start, "check", ctx->filename);
+    if (! ctx->fail_fast_stop) {
+	if (opts.numa != NUMA_NONE) {
+	    checkFunctionsNuma(checkVec);
+	}
+	else {
+	    checkFunctions(checkVec);
+	}
+    }
+    PROBE3(phase__end, "check", ctx->filename, PROBE_USECS(start));
+    ctx->check_secs = omp_get_wtime() - start;
+    ctx->check_cpu = cpuSecs() - start_cpu;
+    ctx->max_threads = std::max(ctx->max_threads, numThreads());
+
+    if (opts.xed_cache != NULL && opts.in_process) {
+	xed_pending_mutex.lock();
+	xed_pending.insert(ctx->check_stats.new_verdicts.begin(),
+			   ctx->check_stats.new_verdicts.end());
+	xed_pending_mutex.unlock();
+    }
+    else if (opts.xed_cache != NULL) {
+	saveXedCache(opts.xed_cache, ctx->check_stats.new_verdicts);
     }
 
+    printSamples(KIND_BAD_LENGTH);
+    printSamples(KIND_BLOCK);
+
     // ------------------------------------------------------------
     // Phase 3 -- test for gaps between basic blocks
     // ------------------------------------------------------------
     cout << nl << "phase 3 -- test for gaps between blocks ..." << nl << endl;
 
-    doGaps(funcVec);
+    start = omp_get_wtime();
+    start_cpu = cpuSecs();
+    PROBE2(phase__start, "gaps", ctx->filename);
+    if (! ctx->fail_fast_stop) {
+	doGaps(funcVec);
+    }
+    PROBE3(phase__end, "gaps", ctx->filename, PROBE_USECS(start));
+    ctx->gaps_secs = omp_get_wtime() - start;
+    ctx->gaps_cpu = cpuSecs() - start_cpu;
+    ctx->max_threads = std::max(ctx->max_threads, numThreads());
+
+    printSamples(KIND_GAP);
+    printSamples(KIND_OVERLAP);
+
+    if (opts.objdump != NULL) {
+	cout << nl << "objdump -- compare dyninst, xed and objdump lengths ..."
+	     << nl << endl;
+
+	compareObjdump(ctx->check_stats.bounds);
+    }
+
+    if (opts.boundaries) {
+	cout << nl << "boundaries -- check line table rows and relocations ..."
+	     << nl << endl;
+
+	checkBoundaries(ctx->check_stats.bounds);
+    }
+
+    vector <Finding> findings;
+
+    if (ctx->want_findings) {
+	vector <Address> unknownAddrs;
+
+	findings = ctx->check_stats.findings;
+	getUnknownAddrs(code_src, unknownAddrs);
+	for (auto it = unknownAddrs.begin(); it != unknownAddrs.end(); ++it) {
+	    findings.push_back(Finding(*it, KIND_UNKNOWN));
+	}
+	findings.insert(findings.end(), ctx->gap_findings.begin(), ctx->gap_findings.end());
+    }
+
+    if (opts.source) {
+	printSourceAttribution(findings);
+    }
 
     // ------------------------------------------------------------
     // Summary of results
@@ -695,19 +2761,67 @@ main(int argc, char **argv)
     printf("\nSummary:\n");
 
     printf("\nfile: %s\n"
-	   "threads: %d  fix valid: %d  fix troll: %d\n",
-	   opts.filename, opts.jobs, opts.fix_valid, opts.fix_troll);
+	   "threads: %d  check threads: %d  fix valid: %d  fix troll: %d\n",
+	   ctx->filename, ctx->jobs, ctx->check_jobs, ctx->fix_valid, ctx->fix_troll);
 
     printf("\nfuncs: %ld  blocks: %ld  instns: %ld  bytes: %ld\n",
-	   funcVec.size(), num_blocks, num_instns, num_bytes);
+	   funcVec.size(), ctx->check_stats.num_blocks, ctx->check_stats.num_instns,
+	   ctx->check_stats.num_bytes);
+
+    printf("code bytes: %ld  covered: %ld  (%.2f%%)\n", ctx->code_bytes, ctx->covered_bytes,
+	   (ctx->code_bytes > 0) ? 100.0 * ctx->covered_bytes / ctx->code_bytes : 0.0);
+
+    if (opts.clones) {
+	long num_funcs = funcVec.size();
+	long num_bytes = ctx->check_stats.num_bytes;
+
+	printf("clones: groups: %ld  clones: %ld of %ld funcs (%.2f%%)"
+	       "  bytes not checked: %ld (%.2f%%)  hash: %.2f sec\n",
+	       ctx->num_clone_groups, ctx->num_clones, num_funcs,
+	       (num_funcs > 0) ? 100.0 * ctx->num_clones / num_funcs : 0.0,
+	       ctx->clone_bytes, (num_bytes > 0) ? 100.0 * ctx->clone_bytes / num_bytes : 0.0,
+	       ctx->clone_secs);
+    }
+    if (ctx->offsets != NULL) {
+	printf("offsets: %s  (funcs in range: %ld of %ld)\n", ctx->offsets,
+	       (long) funcVec.size(), num_all_funcs);
+    }
+    if (opts.eh_frame) {
+	printf("eh_frame: fdes: %ld  seeded: %ld  fde bytes: %ld  covered: %ld  (%.2f%%)"
+	       "  missed: %ld  (%.2f sec)\n",
+	       (long) ctx->fde_ranges.size(), ctx->num_fde_seeded, ctx->fde_bytes, ctx->fde_covered,
+	       (ctx->fde_bytes > 0) ? 100.0 * ctx->fde_covered / ctx->fde_bytes : 0.0,
+	       ctx->num_fde_missed, ctx->eh_secs);
+    }
+
+    printf("\ntime:  parse: %.2f  check: %.2f  gaps: %.2f  sec\n",
+	   ctx->parse_secs, ctx->check_secs, ctx->gaps_secs);
+
+    // getrusage is for the whole process, so not per file in-process
+    if (! opts.in_process) {
+	printf("cpu:   parse: %.2f  check: %.2f  gaps: %.2f  sec\n"
+	       "util:  parse: %.0f%% of %d  check: %.0f%% of %d  gaps: %.0f%% of 1"
+	       "  max threads: %ld  (tbb limit: %d)\n",
+	       ctx->parse_cpu, ctx->check_cpu, ctx->gaps_cpu,
+	       utilization(ctx->parse_cpu, ctx->parse_secs, ctx->jobs), ctx->jobs,
+	       utilization(ctx->check_cpu, ctx->check_secs, ctx->check_jobs), ctx->check_jobs,
+	       utilization(ctx->gaps_cpu, ctx->gaps_secs, 1),
+	       ctx->max_threads, std::max(ctx->jobs, ctx->check_jobs));
+    }
 
     printf("\nunknown: %ld  valid: %ld  troll: %ld  error: %ld\n",
-	   num_unknown, num_unknown_valid, num_unknown_troll, num_unknown_error);
+	   ctx->num_unknown, ctx->num_unknown_valid, ctx->num_unknown_troll, ctx->num_unknown_error);
+    if (ctx->fix_valid) {
+	printf("fixed as branch, call or return: %ld\n", ctx->num_fix_branch.load());
+    }
 
-    printf("\nnum bad length: %ld\n", num_bad_length);
-    if (num_block_align_errors > 0 || num_block_length_errors > 0) {
+    printf("\nnum bad length: %ld\n", ctx->check_stats.num_bad_length);
+    if (ctx->check_stats.num_desync > 0) {
+	printf("desync points: %ld\n", ctx->check_stats.num_desync);
+    }
+    if (ctx->check_stats.num_block_align_errors > 0 || ctx->check_stats.num_block_length_errors > 0) {
 	printf("num align errors: %ld   num length errors: %ld\n",
-	       num_block_align_errors, num_block_length_errors);
+	       ctx->check_stats.num_block_align_errors, ctx->check_stats.num_block_length_errors);
     }
 
     printf("\nnum gaps: %8ld    size: %10ld\n"
@@ -716,11 +2830,156 @@ main(int argc, char **argv)
 	   "under 256: %7ld    size: %10ld\n"
 	   "other:    %8ld    size: %10ld\n"
 	   "num blocks overlap:  %ld\n",
-	   num_gaps, size_gaps, num_gaps_16, size_gaps_16,
-	   num_gaps_64, size_gaps_64, num_gaps_256, size_gaps_256,
-	   num_gaps_other, size_gaps_other, num_overlap);
+	   ctx->num_gaps, ctx->size_gaps, ctx->num_gaps_16, ctx->size_gaps_16,
+	   ctx->num_gaps_64, ctx->size_gaps_64, ctx->num_gaps_256, ctx->size_gaps_256,
+	   ctx->num_gaps_other, ctx->size_gaps_other, ctx->num_overlap);
+
+    if (opts.boundaries) {
+	printf("\nline rows: %ld  in instns: %ld  mid-instn: %ld\n"
+	       "relocs: %ld  in instns: %ld  bad: %ld\n",
+	       ctx->bound_num_lines, ctx->bound_lines_checked, ctx->bound_lines_bad,
+	       ctx->bound_num_relocs, ctx->bound_relocs_checked, ctx->bound_relocs_bad);
+    }
+
+    if (opts.objdump != NULL) {
+	printf("\nobjdump: %s  instns: %ld  matched: %ld  agree: %ld  not in objdump: %ld\n"
+	       "dyninst wrong: %ld  xed wrong: %ld  objdump differs: %ld  all differ: %ld\n"
+	       "objdump read: %.1f MB  %.2f sec\n",
+	       opts.objdump, ctx->objdump_num_insns, ctx->objdump_matched, ctx->objdump_agree,
+	       ctx->objdump_missing, ctx->objdump_dyn_wrong, ctx->objdump_xed_wrong, ctx->objdump_differs,
+	       ctx->objdump_all_differ, ctx->objdump_bytes / 1048576.0, ctx->objdump_secs);
+    }
+
+    if (opts.profile != NULL) {
+	printProfileSummary(funcVec, findings);
+    }
+    if (opts.verdicts != NULL) {
+	writeVerdicts(opts.verdicts, allFuncs, funcVec, findings);
+    }
+
+    printRecordCounts();
+
+    if (opts.xed_cache != NULL) {
+	printf("\nxed cache:  loaded: %ld  hits: %ld  new: %ld\n",
+	       xed_cache_loaded, ctx->check_stats.num_cache_hits,
+	       (long) xed_cache.size() - xed_cache_loaded);
+    }
+
+    if (opts.numa != NUMA_NONE) {
+	printf("\nnuma: %s\n", (opts.numa == NUMA_SPREAD) ? "spread" : "compact");
+
+	for (long k = 0; k < (long) ctx->node_stats.size(); k++) {
+	    NodeStats & ns = ctx->node_stats[k];
+	    double rate = (ns.thread_secs > 0.0) ? ns.num_instns / ns.thread_secs : 0.0;
+
+	    printf("node %d:  cpus: %ld  threads: %ld  cfg funcs: %ld  local: %ld  remote: %ld"
+		   "  instns: %ld  instns/thread-sec: %.0f\n",
+		   numa_nodes[k].node, (long) numa_nodes[k].cpus.size(), ns.threads,
+		   ns.cfg_funcs, ns.local_funcs, ns.remote_funcs, ns.num_instns, rate);
+	}
+    }
+
+    if (ctx->kv_out != NULL) {
+	writeKeyValues(ctx->kv_out, funcVec.size());
+    }
+
+    if (opts.history != NULL && ! ctx->fail_fast_stop) {
+	appendHistory(opts.history, funcVec.size());
+    }
+
+    // a partial check would skew the phase 2 model
+    if (opts.jobs_profile != NULL && ctx->offsets == NULL && opts.hot_pct >= 100.0
+	&& ! ctx->fail_fast_stop && text_bytes > 0.0) {
+	appendJobsProfile(opts.jobs_profile, text_bytes, num_syms, ctx->parse_secs,
+			  ctx->check_secs);
+    }
+
+    // exit status 2 for ci scripts
+    int ret = 0;
+
+    if (ctx->failed) {
+	printf("\nerror: %s\n", ctx->error.c_str());
+	ret = 1;
+    }
+    else if (ctx->fail_fast_stop) {
+	printf("\nstopped early after %ld problems (fail fast: %ld)\n",
+	       (long) ctx->num_problems, opts.fail_fast);
+	ret = 2;
+    }
 
     cout << endl;
 
-    return 0;
+    // a forked child just exits, but in-process, free the CFG and
+    // the Symtab for the next file
+    if (opts.in_process) {
+	delete code_obj;
+	delete code_src;
+	if (ctx->symtab != NULL) {
+	    Symtab::closeSymtab(ctx->symtab);
+	}
+    }
+    omp_set_num_threads(saved_threads);
+    endAnalysis();
+
+    return ret;
+}
+
+//----------------------------------------------------------------------
+
+int
+main(int argc, char **argv)
+{
+    getOptions(argc, argv, opts);
+
+    if (opts.history_report) {
+	return historyReport(opts.filename);
+    }
+
+    if (opts.builds != NULL) {
+	return runBuilds(argv);
+    }
+
+    cout << "file: " << opts.filename << "\n";
+    if (opts.diff_old != NULL) {
+	cout << "old file: " << opts.diff_old << "\n";
+    }
+    if (opts.jobs_auto) {
+	cout << "threads: auto  check threads: "
+	     << (opts.check_jobs_set ? std::to_string(opts.check_jobs) : "auto");
+    }
+    else {
+	cout << "threads: " << opts.jobs
+	     << "  check threads: " << opts.check_jobs;
+    }
+    cout << "  fix valid: " << opts.fix_valid
+	 << "  fix troll: " << opts.fix_troll << endl;
+
+    xed_tables_init();
+
+    if (opts.diff_old != NULL) {
+	return diffEncodings();
+    }
+
+    if (opts.queue_merge) {
+	return mergeQueue();
+    }
+
+    if (opts.corpus && opts.queue != NULL) {
+	return runQueue();
+    }
+
+    if (opts.archive) {
+	return runArchive();
+    }
+
+    if (opts.corpus) {
+	return runCorpus();
+    }
+
+    Analysis an(opts.filename);
+    an.offsets = opts.offsets;
+    an.kv_out = opts.kv_out;
+
+    return analyzeFile(an);
 }
+
@@ -0,0 +1,185 @@
+//
+//  Copyright (c) 2023, Rice University
+//  All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//  
+//  1. Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//  
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//  
+//  3. Neither the name of the copyright holder nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------
+//
+//  Checker library API.  The same checks as the unknown-x86 program
+//  (unknown instructions, bad lengths, block errors, gaps and
+//  overlaps), for a program that already has a Symtab and CodeObject
+//  and wants the results as data instead of scraping stdout.
+//
+//  Build libunknown-x86.so with:  ./mk-test.sh --lib
+//  (checker.cpp, the checker core without the program's modes).
+//
+//  Usage:
+//
+//    CheckerOptions options;
+//    options.check_jobs = 8;
+//    checkerInit(options);
+//
+//    CodeObject * code_obj = new CodeObject(new SymtabCodeSource(symtab));
+//    CheckerResult result;
+//    long problems = checkCodeObject(code_obj, CheckerRanges(), result);
+//
+//  checkCodeObject() parses the CodeObject with the unknown
+//  instruction callback in place, so the caller can use the same CFG
+//  afterwards without a second parse.  If the CodeObject is already
+//  parsed, there are no unknown instruction findings.
+//
+//  checkerInit() registers the callback (once for the process) and
+//  sets the default options.  The options can also be passed per call,
+//  and checkCodeObject() is reentrant:  several CodeObjects may be
+//  checked at once from different threads, with different options.
+//  It passes its thread counts to OpenMP and TBB per call and leaves
+//  the caller's OpenMP and TBB settings as they were.
+//
+// ----------------------------------------------------------------------
+
+#ifndef UNKNOWN_X86_H
+#define UNKNOWN_X86_H
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Dyninst {
+namespace ParseAPI {
+    class CodeObject;
+}
+}
+
+// Kinds of findings (and output records)
+namespace CheckerKind {
+    enum {
+	KIND_UNKNOWN = 0,
+	KIND_BAD_LENGTH = 1,
+	KIND_BLOCK = 2,
+	KIND_GAP = 3,
+	KIND_OVERLAP = 4,
+	NUM_KINDS = 5
+    };
+}
+
+class CheckerOptions {
+public:
+    int   jobs;         // openmp threads for parse
+    int   check_jobs;   // threads for phase 2 checking
+    bool  fix_valid;    // fix unknown instructions that xed decodes
+    bool  fix_troll;    // also fix out of sync (trolled) instructions
+
+    CheckerOptions() {
+	jobs = 1;
+	check_jobs = 1;
+	fix_valid = false;
+	fix_troll = false;
+    }
+};
+
+// Check only the functions with entry address in these [lo, hi)
+// ranges, empty means all functions.
+typedef std::vector <std::pair <uint64_t, uint64_t>> CheckerRanges;
+
+// One finding.  funcs is the entry addresses (sorted) of all the
+// functions with a block containing addr (a block may be shared),
+// func is the first of them, or 0 if none, and size is only for gaps.
+class CheckerFinding {
+public:
+    uint64_t  addr;
+    uint64_t  func;
+    int   kind;
+    long  size;
+    std::vector <uint64_t>  funcs;
+};
+
+class CheckerResult {
+public:
+    long  funcs;
+    long  blocks;
+    long  instns;
+    long  bytes;
+    long  covered_bytes;
+    long  unknown;
+    long  unknown_valid;
+    long  unknown_troll;
+    long  unknown_error;
+    long  bad_length;
+    long  block_errors;
+    long  gaps;
+    long  gap_bytes;
+    long  overlap;
+    double  parse_secs;
+    double  check_secs;
+    double  gaps_secs;
+
+    // sorted by address
+    std::vector <CheckerFinding> findings;
+
+    // empty, or why the check stopped (too many xed errors in a row,
+    // out of memory), then checkCodeObject() returns -1
+    std::string  error;
+
+    CheckerResult() {
+	funcs = 0;
+	blocks = 0;
+	instns = 0;
+	bytes = 0;
+	covered_bytes = 0;
+	unknown = 0;
+	unknown_valid = 0;
+	unknown_troll = 0;
+	unknown_error = 0;
+	bad_length = 0;
+	block_errors = 0;
+	gaps = 0;
+	gap_bytes = 0;
+	overlap = 0;
+	parse_secs = 0.0;
+	check_secs = 0.0;
+	gaps_secs = 0.0;
+    }
+};
+
+// Set the default options, init the xed tables and register the
+// unknown instruction callback.  Call before any checkCodeObject().
+void checkerInit(const CheckerOptions & options);
+
+// Parse and check one CodeObject, fill in result and return the
+// number of confirmed problems (unknown valid or troll, bad length
+// and block errors), or -1 with result.error set if the check failed.
+// It never exits the process.
+long checkCodeObject(Dyninst::ParseAPI::CodeObject * code_obj,
+		     const CheckerRanges & ranges, CheckerResult & result);
+
+// The same with options for this call only.
+long checkCodeObject(Dyninst::ParseAPI::CodeObject * code_obj,
+		     const CheckerRanges & ranges, const CheckerOptions & options,
+		     CheckerResult & result);
+
+#endif
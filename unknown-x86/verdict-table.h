@@ -0,0 +1,112 @@
+//
+//  Copyright (c) 2023, Rice University
+//  All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//  
+//  1. Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//  
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//  
+//  3. Neither the name of the copyright holder nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------
+//
+//  Format of the per-function verdict table written by unknown-x86
+//  --verdicts file.  The table is meant to be mapped (mmap) at startup
+//  by an instrumenter, which looks up each function by its entry
+//  address and skips the functions with a broken CFG.
+//
+//  The file is a header followed by num_records records, sorted by
+//  entry address.  All fields are native (little) endian.
+//
+//  This file is plain C, so it can be included from C or C++.
+//
+// ----------------------------------------------------------------------
+
+#ifndef UNKNOWN_X86_VERDICT_TABLE_H
+#define UNKNOWN_X86_VERDICT_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define VERDICT_MAGIC    "UX86VRDT"
+#define VERDICT_VERSION  1
+
+// verdict flags, zero means ok
+#define VERDICT_OK          0x00
+#define VERDICT_UNKNOWN     0x01   // hit the unknown instruction callback
+#define VERDICT_BAD_LENGTH  0x02   // dyninst and xed lengths differ
+#define VERDICT_TRUNCATED   0x04   // block error or large gap (64+ bytes)
+#define VERDICT_OVERLAP     0x08   // overlapping blocks
+#define VERDICT_UNCHECKED   0x10   // not checked in phase 2 (--offsets, --hot)
+
+struct verdict_header {
+    char      magic[8];
+    uint32_t  version;
+    uint32_t  record_size;
+    uint64_t  num_records;
+    uint64_t  file_size;      // size of the analyzed binary
+};
+
+struct verdict_record {
+    uint64_t  entry;          // function entry address
+    uint32_t  flags;          // VERDICT_* bits
+    uint32_t  num_problems;   // findings in the function
+};
+
+// Return the record for the function at entry, or NULL if the table
+// is invalid or has no such function.
+static inline const struct verdict_record *
+verdict_lookup(const void * table, size_t size, uint64_t entry)
+{
+    const struct verdict_header * hdr = (const struct verdict_header *) table;
+    const struct verdict_record * rec;
+    uint64_t lo, hi;
+
+    if (table == NULL || size < sizeof(*hdr)
+	|| memcmp(hdr->magic, VERDICT_MAGIC, 8) != 0
+	|| hdr->version != VERDICT_VERSION
+	|| hdr->record_size != sizeof(*rec)
+	|| hdr->num_records > (size - sizeof(*hdr)) / sizeof(*rec)) {
+	return NULL;
+    }
+    rec = (const struct verdict_record *) (hdr + 1);
+
+    lo = 0;
+    hi = hdr->num_records;
+    while (lo < hi) {
+	uint64_t mid = lo + (hi - lo) / 2;
+
+	if (rec[mid].entry < entry) {
+	    lo = mid + 1;
+	}
+	else {
+	    hi = mid;
+	}
+    }
+    if (lo < hdr->num_records && rec[lo].entry == entry) {
+	return &rec[lo];
+    }
+    return NULL;
+}
+
+#endif